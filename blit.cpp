@@ -0,0 +1,95 @@
+#include <Arduino.h>
+
+#include "display.h"
+#include "blit.h"
+#include "spiqueue.h"
+
+#define STACK_HEIGHT (3*BLOCK_STEP + 1)
+
+// a run of pixels that has not been sent yet, so that runs of the same
+// colour sent one after the other go out as one command
+static uint16_t pendingColour;
+static uint16_t pendingCount = 0;
+
+/*Sends the pending run of pixels, if any.*/
+static void blitFlush() {
+    if (pendingCount > 0) {
+        displayColour(pendingColour, pendingCount);
+        pendingCount = 0;
+    }
+}
+
+/*Fills in the palette used by blitRows. Call once after displayBegin().*/
+void blitInit() {
+    for (int c = 0; c < NUM_SHADES; ++c) {
+        displaySetColour(c, pgm_read_word(&shadeColour[c]));
+    }
+    displaySetColour(PALETTE_WHITE, WHITE);
+    displaySetColour(PALETTE_RED, RED);
+}
+
+/*Opens an address window on the display and starts a burst of pixel data.
+The window is filled left to right, top to bottom, and must be on screen.*/
+void blitBegin(int x0, int y0, int x1, int y1) {
+    blitFlush();
+    displayWindow(x0, y0, x1, y1);
+}
+
+/*Sends count pixels of one colour as part of the current burst.*/
+void blitColour(uint16_t colour, int count) {
+    if (pendingCount > 0 && colour != pendingColour) {
+        blitFlush();
+    }
+    pendingColour = colour;
+    pendingCount += count;
+}
+
+/*Sends rows of the current burst that each have one left pixel, width
+inside pixels and one right pixel (none if right is PALETTE_NONE). The
+colours are palette indices. The whole run of rows is a single command.*/
+void blitRows(uint8_t left, uint8_t inside, uint8_t right, int width, int rows) {
+    blitFlush();
+    displayRows(left, inside, right, width, rows);
+}
+
+/*Ends the current burst, sending the pixels still pending.*/
+void blitEnd() {
+    blitFlush();
+}
+
+/*Streams rows first to last of a stack of blocks at (x, y), where row 0 is
+the top border of the top block, colouring the inside of each block with
+its colour (colours[0] is the top block). Every border row and every block
+inside is one command.*/
+static void blitTemplate(int x, int y, int first, int last, const Shade* colours) {
+    blitBegin(x, y, x + COL_WIDTH - 1, y + last - first);
+    int r = first;
+    while (r <= last) {
+        if (r % BLOCK_STEP == 0) { // a border row, all white
+            blitRows(PALETTE_WHITE, PALETTE_WHITE, PALETTE_WHITE, COL_WIDTH - 2, 1);
+            ++r;
+            continue;
+        }
+        // the inside of a block runs up to the next border row
+        int end = (r / BLOCK_STEP + 1) * BLOCK_STEP;
+        if (end > last + 1) {
+            end = last + 1;
+        }
+        blitRows(PALETTE_WHITE, colours[r / BLOCK_STEP], PALETTE_WHITE, COL_WIDTH - 2, end - r);
+        r = end;
+    }
+    blitEnd();
+}
+
+/*Draws one bordered block with its top left corner at (x, y).*/
+void blitBlock(int x, int y, Shade colour) {
+    Shade colours[1] = {colour};
+    blitTemplate(x, y, 0, BLOCK_HEIGHT - 1, colours);
+}
+
+/*Draws a stack of three blocks in one burst. Like the falling stack, (x, y)
+is the top left corner of the bottom block.*/
+void blitStack(int x, int y, Shade Bcolour, Shade Mcolour, Shade Tcolour) {
+    Shade colours[3] = {Tcolour, Mcolour, Bcolour};
+    blitTemplate(x, y - 2*BLOCK_STEP, 0, STACK_HEIGHT - 1, colours);
+}
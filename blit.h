@@ -0,0 +1,29 @@
+/*Fast drawing of whole blocks and stacks. Each call opens one address
+window on the display and streams every pixel of it in a single SPI
+burst, instead of one drawRect plus one fillRect (and their separate
+windows and transfers) per block. The bursts are sent by spiqueue.h.
+Rows that repeat (the inside of a block, a run of identical playfield
+rows) are sent as a single command that refers to its colours through a
+small palette.*/
+
+#ifndef BLIT_H
+#define BLIT_H
+
+#include <stdint.h>
+
+#include "engine.h"
+
+// palette indices for blitRows, the Shades use their own value as index
+#define PALETTE_WHITE 7
+#define PALETTE_RED 8
+
+void blitInit();
+void blitBegin(int x0, int y0, int x1, int y1);
+void blitColour(uint16_t colour, int count);
+void blitRows(uint8_t left, uint8_t inside, uint8_t right, int width, int rows);
+void blitEnd();
+
+void blitBlock(int x, int y, Shade colour);
+void blitStack(int x, int y, Shade Bcolour, Shade Mcolour, Shade Tcolour);
+
+#endif
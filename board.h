@@ -0,0 +1,244 @@
+/*The grid of blocks as a template on its width, height and number of
+colours, so boards other than the 6x15 one of the game (8x20, 7 colours,
+...) cost nothing at run time: every size is a compile-time constant,
+the masks are the smallest unsigned type that holds a column, and every
+loop over the columns is unrolled by template recursion.
+
+Each colour is kept as one bit mask per column (bit j = row j), as in
+engine.cpp. RunFinder holds the kernel that finds runs of 3. The engine
+uses it for the game's own grid. Board<W, H, C> is a whole board built
+on it (landing, removing, gravity and cascades) for the host tools that
+try out other sizes.*/
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdint.h>
+
+/*The smallest unsigned type with at least H bits.*/
+template <int H, bool Byte = (H <= 8), bool Word = (H <= 16), bool Long = (H <= 32)>
+struct ColumnMask;
+template <int H> struct ColumnMask<H, true, true, true> { typedef uint8_t type; };
+template <int H> struct ColumnMask<H, false, true, true> { typedef uint16_t type; };
+template <int H> struct ColumnMask<H, false, false, true> { typedef uint32_t type; };
+template <int H> struct ColumnMask<H, false, false, false> { typedef uint64_t type; };
+
+/*The mask of a whole column of H blocks.*/
+template <typename Mask, int H>
+constexpr Mask fullColumn() {
+    return H >= (int) (8 * sizeof(Mask)) ? (Mask) ~(Mask) 0 : (Mask) (((uint64_t) 1 << H) - 1);
+}
+
+/*Runs of 3 in column I, then in every column after it. With Sparse,
+columns without dirty blocks are skipped.*/
+template <typename Mask, int W, bool Sparse, int I = 0, bool End = (I >= W)>
+struct ColumnRuns {
+    static inline void find(const Mask* m, const Mask* d, Mask* match) {
+        if (Sparse && d[I] == 0) {
+            ColumnRuns<Mask, W, Sparse, I + 1>::find(m, d, match);
+            return;
+        }
+        Mask v = m[I] & (Mask) (m[I] >> 1) & (Mask) (m[I] >> 2);
+        v &= d[I] | (Mask) (d[I] >> 1) | (Mask) (d[I] >> 2);
+        match[I] |= v | (Mask) (v << 1) | (Mask) (v << 2);
+        ColumnRuns<Mask, W, Sparse, I + 1>::find(m, d, match);
+    }
+};
+template <typename Mask, int W, bool Sparse, int I>
+struct ColumnRuns<Mask, W, Sparse, I, true> {
+    static inline void find(const Mask*, const Mask*, Mask*) {}
+};
+
+/*Runs of 3 across columns I to I+2 (in a row and on both diagonals),
+then for every I after it.*/
+template <typename Mask, int W, bool Sparse, int I = 0, bool End = (I + 2 >= W)>
+struct LineRuns {
+    static inline void find(const Mask* m, const Mask* d, Mask* match) {
+        if (Sparse && (d[I] | d[I+1] | d[I+2]) == 0) {
+            LineRuns<Mask, W, Sparse, I + 1>::find(m, d, match);
+            return;
+        }
+        Mask h = m[I] & m[I+1] & m[I+2];
+        Mask r = m[I] & (Mask) (m[I+1] >> 1) & (Mask) (m[I+2] >> 2); // up and right
+        Mask l = m[I] & (Mask) (m[I+1] << 1) & (Mask) (m[I+2] << 2); // down and right
+        h &= d[I] | d[I+1] | d[I+2];
+        r &= d[I] | (Mask) (d[I+1] >> 1) | (Mask) (d[I+2] >> 2);
+        l &= d[I] | (Mask) (d[I+1] << 1) | (Mask) (d[I+2] << 2);
+        match[I] |= h | r | l;
+        match[I+1] |= h | (Mask) (r << 1) | (Mask) (l >> 1);
+        match[I+2] |= h | (Mask) (r << 2) | (Mask) (l >> 2);
+        LineRuns<Mask, W, Sparse, I + 1>::find(m, d, match);
+    }
+};
+template <typename Mask, int W, bool Sparse, int I>
+struct LineRuns<Mask, W, Sparse, I, true> {
+    static inline void find(const Mask*, const Mask*, Mask*) {}
+};
+
+/*Marks in match every run of 3 or more of one colour in a column, row or
+diagonal of a W x H grid that passes through a block in d. m holds the
+blocks of that colour and d the dirty ones among them. The masks of a
+colour never have bits above row H-1, so no shift can make a run out of
+the bits beyond the top.
+
+With Sparse, the columns and groups of three columns without a dirty
+block are skipped. That is a branch per column, but it pays off when
+only a few blocks are dirty, as after a stack lands. Without it the
+kernel has no branches at all.*/
+template <int W, int H, bool Sparse = false>
+struct RunFinder {
+    typedef typename ColumnMask<H>::type Mask;
+
+    static inline void find(const Mask* m, const Mask* d, Mask* match) {
+        ColumnRuns<Mask, W, Sparse>::find(m, d, match);
+        LineRuns<Mask, W, Sparse>::find(m, d, match);
+    }
+};
+
+/*A whole board of W columns of H blocks in C colours (1 to C, 0 is an
+empty cell), with the same rules as the game: stacks of 3 land on top of
+a column, runs of 3 or more disappear, the blocks above fall into the
+gaps, and the board is checked again until nothing more happens.*/
+template <int W, int H, int C>
+struct Board {
+    typedef typename ColumnMask<H>::type Mask;
+    static const int width = W;
+    static const int height = H;
+    static const int colours = C;
+
+    uint8_t cells[W][H]; // [0][0] is the bottom left
+    Mask colourMask[C + 1][W]; // colourMask[0] holds the empty cells
+    Mask dirty[W]; // blocks placed or moved since the last check
+    Mask match[W];
+    int32_t score;
+    int level;
+
+    void clear() {
+        for (int i = 0; i < W; ++i) {
+            for (int j = 0; j < H; ++j) {
+                cells[i][j] = 0;
+            }
+            for (int c = 0; c <= C; ++c) {
+                colourMask[c][i] = c == 0 ? fullColumn<Mask, H>() : 0;
+            }
+            dirty[i] = 0;
+            match[i] = 0;
+        }
+        score = 0;
+        level = 1;
+    }
+
+    void set(int col, int row, uint8_t colour) {
+        Mask bit = (Mask) 1 << row;
+        colourMask[cells[col][row]][col] &= (Mask) ~bit;
+        colourMask[colour][col] |= bit;
+        dirty[col] |= colour != 0 ? bit : 0;
+        cells[col][row] = colour;
+    }
+
+    /*The row the bottom block of a stack dropped into col lands in, H if
+    the column is full. The blocks of a column always sit at the bottom.*/
+    int landingRow(int col) const {
+        return __builtin_popcountll((uint64_t) (Mask) ~colourMask[0][col] & fullColumn<Mask, H>());
+    }
+
+    /*Lands a stack (bottom colour first) on top of a column. Blocks above
+    the top of the board are lost. Returns the row of the bottom block.*/
+    int land(int col, const uint8_t stack[3]) {
+        int row = landingRow(col);
+        for (int k = 0; k < 3 && row + k < H; ++k) {
+            set(col, row + k, stack[k]);
+        }
+        return row;
+    }
+
+    /*Marks every run of 3 through a dirty block in match. Returns whether
+    there were any.*/
+    bool findMatches() {
+        for (int c = 1; c <= C; ++c) {
+            Mask d[W];
+            for (int i = 0; i < W; ++i) {
+                d[i] = colourMask[c][i] & dirty[i];
+            }
+            RunFinder<W, H>::find(colourMask[c], d, match);
+        }
+        Mask found = 0;
+        for (int i = 0; i < W; ++i) {
+            found |= match[i];
+            dirty[i] = 0;
+        }
+        return found != 0;
+    }
+
+    /*Empties the matched cells and scores them. Returns how many there were.*/
+    int removeMatches() {
+        int removed = 0;
+        for (int i = 0; i < W; ++i) {
+            Mask keep = (Mask) ~match[i];
+            for (int j = 0; j < H; ++j) {
+                cells[i][j] &= (uint8_t) -(int) ((keep >> j) & 1); // 0 where matched
+            }
+            for (int c = 1; c <= C; ++c) {
+                colourMask[c][i] &= keep;
+            }
+            colourMask[0][i] |= match[i];
+            removed += __builtin_popcountll(match[i]);
+            match[i] = 0;
+        }
+        score += removed * level;
+        return removed;
+    }
+
+    /*Lets every block fall to the bottom of its column in one go, by
+    packing the non-empty cells of each column down. Returns whether
+    anything moved; what did is marked dirty.*/
+    bool settle() {
+        Mask movedAll = 0;
+        for (int i = 0; i < W; ++i) {
+            uint8_t packed[H];
+            int k = 0;
+            for (int j = 0; j < H; ++j) {
+                packed[k] = cells[i][j];
+                k += cells[i][j] != 0;
+            }
+            Mask moved = 0;
+            for (int j = 0; j < H; ++j) {
+                uint8_t colour = j < k ? packed[j] : 0;
+                moved |= (Mask) (colour != cells[i][j]) << j;
+                cells[i][j] = colour;
+            }
+            Mask filled = (Mask) (((uint64_t) 1 << k) - 1);
+            for (int c = 1; c <= C; ++c) {
+                Mask mask = 0;
+                for (int j = 0; j < H; ++j) {
+                    mask |= (Mask) (cells[i][j] == c) << j;
+                }
+                colourMask[c][i] = mask;
+            }
+            colourMask[0][i] = (Mask) ~filled & fullColumn<Mask, H>();
+            dirty[i] |= moved & filled;
+            movedAll |= moved;
+        }
+        return movedAll != 0;
+    }
+
+    /*Removes runs and lets the blocks fall until the board is still.
+    Returns the number of times blocks were removed.*/
+    int resolve() {
+        int steps = 0;
+        while (findMatches()) {
+            removeMatches();
+            ++steps;
+            settle();
+        }
+        return steps;
+    }
+
+    /*Whether a stack that landed at row has left a block in the second
+    row from the top, which ends the game.*/
+    bool overflowed(int col, int row) const {
+        return row >= H - 3 && cells[col][H - 2] != 0;
+    }
+};
+
+#endif
@@ -0,0 +1,43 @@
+/*Colours, pins and screen layout shared by everything that draws
+to the TFT display.*/
+
+#ifndef DISPLAY_H
+#define DISPLAY_H
+
+#include <Adafruit_ST7735.h>
+
+#include "engine.h"
+
+// colour definitions
+#define BLACK    0x0000
+#define BLUE     0x001F
+#define RED      0xF800
+#define GREEN    0x07E0
+#define CYAN     0x07FF
+#define MAGENTA  0xF81F
+#define YELLOW   0xFFE0
+#define WHITE    0xFFFF
+#define ORANGE   0xFA00
+#define BROWN    0x99E0 //got this by experimenting
+
+#define TFT_CS   6  // Chip select line for TFT display
+#define TFT_DC   7  // Data/command line for TFT
+#define TFT_RST  8  // Reset line for TFT (or connect to +5V)
+#define SD_CS    5  // Chip select line for the SD card on the TFT breakout
+
+#define SCREEN_SIZE_X 128 //horizontal size of screen
+#define SCREEN_SIZE_Y 160 //vertical size of screen
+
+#define COL_WIDTH 11 // = each column is a 10x10 pixel coloured block with a white border on the top and side right
+#define BLOCK_HEIGHT 11
+#define BLOCK_STEP 10 // neighbouring blocks share a border, so they are 10 pixels apart
+
+#define GRID_TOP 9 // the top of the grid, just below the red bar
+
+extern Adafruit_ST7735 tft;
+
+// the RGB565 value drawn for each Shade, kept in flash: read it with
+// pgm_read_word, only when a colour is put into the display palette
+extern const uint16_t shadeColour[NUM_SHADES] PROGMEM;
+
+#endif
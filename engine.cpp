@@ -0,0 +1,393 @@
+#include "engine.h"
+#include "board.h"
+#include "profile.h"
+
+#include <string.h>
+
+// the masks in Game are the ones RunFinder uses for this grid
+static_assert(sizeof(RunFinder<NUM_COLS, NUM_ROWS>::Mask) == sizeof(uint16_t), "Game needs other masks");
+
+#ifdef ZOBRIST
+/*splitmix64, used to make the Zobrist keys: any two inputs give
+unrelated 64 bit numbers.*/
+static uint64_t zobristMix(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+// one key per cell and colour, Black is 0 so an empty grid hashes to 0
+static uint64_t cellKeys[NUM_COLS][NUM_ROWS][NUM_SHADES];
+// one key per block of the falling stack and colour
+static uint64_t stackKeys[3][NUM_SHADES];
+
+static struct ZobristKeys {
+    ZobristKeys() {
+        uint64_t n = 1;
+        for (int i = 0; i < NUM_COLS; ++i) {
+            for (int j = 0; j < NUM_ROWS; ++j) {
+                for (int c = 1; c < NUM_SHADES; ++c) {
+                    cellKeys[i][j][c] = zobristMix(n++);
+                }
+            }
+        }
+        for (int k = 0; k < 3; ++k) {
+            for (int c = 1; c < NUM_SHADES; ++c) {
+                stackKeys[k][c] = zobristMix(n++);
+            }
+        }
+    }
+} zobristKeys;
+
+// levels have no upper limit, so their keys are made as they are needed
+static uint64_t levelKey(int level) {
+    return zobristMix(0x4C45564CULL << 32 | (uint32_t) level);
+}
+#endif
+
+/*Empties the grid and starts a new game at level 1 with the given
+number of colours. The seed decides every stack of the game, so two
+games with the same seed and difficulty get the same stacks.*/
+void resetGame(Game* game, int difficulty, uint32_t seed) {
+    memset(game, 0, sizeof(*game));
+    for (int i = 0; i < NUM_COLS; ++i) {
+        game->ShadeMask[Black][i] = (1 << NUM_ROWS) - 1; // every block starts out empty
+    }
+    game->level = 1;
+    game->difficulty = difficulty;
+    game->random = seed != 0 ? seed : DEFAULT_SEED;
+#ifdef ZOBRIST
+    game->zobrist = levelKey(game->level);
+#endif
+}
+
+/*Turns a number from 1 to 6 into a block colour.
+0 (or anything out of range) gives Black.*/
+Shade colourFromNumber(int number) {
+    if (number < 1 || number > 6) {
+        return Black;
+    }
+    return (Shade) number;
+}
+
+/*The next number from the game's xorshift generator (Marsaglia's 13, 17, 5
+triple), which goes through every 32 bit number but 0 before repeating.
+Only shifts and XORs, so it is quick on the Arduino too.*/
+uint32_t nextRandom(Game* game) {
+    uint32_t x = game->random;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    game->random = x;
+    return x;
+}
+
+/*A random block colour out of the first game->difficulty colours, each
+equally likely.*/
+Shade randomShade(Game* game) {
+    // numbers past the last whole multiple of difficulty would favour the
+    // first colours, so they are thrown away
+    uint32_t limit = 65536UL - 65536UL % game->difficulty;
+    uint16_t r;
+    do {
+        r = nextRandom(game) >> 16; // the high bits are the most random
+    } while (r >= limit);
+    return colourFromNumber(r % game->difficulty + 1); // +1 is added to avoid getting Black
+}
+
+/*Picks the colours of a new stack.*/
+void randomStack(Game* game, Shade* Bcolour, Shade* Mcolour, Shade* Tcolour) {
+    *Bcolour = randomShade(game);
+    *Mcolour = randomShade(game);
+    *Tcolour = randomShade(game);
+}
+
+/*Changes the colour of one block, keeping the colour masks in step
+with it. Everything that changes the grid goes through here.
+A block that becomes coloured is marked dirty since it may now be part
+of a sequence; a block that becomes Black cannot be.*/
+void setBlock(Game* game, int col, int row, Shade colour) {
+    uint16_t bit = 1 << row;
+    Shade old = blockAt(game, col, row);
+    game->ShadeMask[old][col] &= ~bit;
+    game->ShadeMask[colour][col] |= bit;
+    if (colour != Black) {
+        game->DirtyMask[col] |= bit;
+    }
+#ifdef ZOBRIST
+    game->zobrist ^= cellKeys[col][row][old] ^ cellKeys[col][row][colour];
+#endif
+    for (int b = 0; b < 3; ++b) {
+        game->ColourBits[b][col] = (game->ColourBits[b][col] & ~bit) | (colour & (1 << b) ? bit : 0);
+    }
+}
+
+/*Places a stack of three blocks into the grid with its bottom block at
+the given row. Blocks that would sit above the top of the grid are lost.*/
+void landStack(Game* game, int col, int row, Shade Bcolour, Shade Mcolour, Shade Tcolour) {
+    Shade colours[3] = {Bcolour, Mcolour, Tcolour};
+    for (int k = 0; k < 3; ++k) {
+        if (row + k < NUM_ROWS) {
+            setBlock(game, col, row + k, colours[k]);
+        }
+    }
+}
+
+/*Returns the lowest empty row of a column, which is where the bottom
+block of a stack dropped into it would land. Returns NUM_ROWS if the
+column is full.*/
+int landingRow(const Game* game, int col) {
+    return __builtin_ctz(game->ShadeMask[Black][col] | 1 << NUM_ROWS);
+}
+
+/*After the checking is complete, determines whether a stack that
+landed at the given row has left a block at the top of the grid.*/
+bool stackOverflowed(const Game* game, int col, int row) {
+    return row >= NUM_ROWS - 3 && blockAt(game, col, NUM_ROWS - 2) != Black;
+}
+
+/*Moves the game up a level.*/
+void nextLevel(Game* game) {
+#ifdef ZOBRIST
+    game->zobrist ^= levelKey(game->level) ^ levelKey(game->level + 1);
+#endif
+    game->level += 1;
+}
+
+// the speeds of levels 1 to 10, about what the old frame loop managed with
+// its delay of 100/level - level ms per pixel
+static const uint16_t levelSpeed[10] = {10, 19, 29, 40, 52, 71, 90, 125, 166, 250};
+
+/*How fast the stack falls at a level, in 1/2^FALL_SHIFT pixels per
+microsecond. After level 10 every level is 10% faster than the one before,
+up to MAX_FALL_SPEED.*/
+uint32_t fallSpeed(int level) {
+    if (level < 1) {
+        level = 1;
+    }
+    if (level <= 10) {
+        return PIXELS_PER_SECOND(levelSpeed[level - 1]);
+    }
+    uint32_t speed = PIXELS_PER_SECOND(levelSpeed[9]);
+    for (int l = 10; l < level && speed < MAX_FALL_SPEED; ++l) {
+        speed += speed / 10;
+    }
+    return speed < MAX_FALL_SPEED ? speed : MAX_FALL_SPEED;
+}
+
+/*Finds every run of 3 or more blocks of the same colour in a row,
+column or diagonal that passes through a dirty block, marks them in the
+MatchMask and clears the DirtyMask.
+
+Each colour is kept as one bit mask per column (bit j = row j), so a
+column run is a mask ANDed with itself shifted down by one and two rows,
+a row run is three neighbouring columns ANDed together, and a diagonal
+run is the same with the second and third columns shifted by one and two
+rows. Longer runs are covered by the overlapping runs of 3. The kernel
+that does this is RunFinder in board.h, unrolled for the 6x15 grid.
+
+Only blocks that were placed or moved since the last check can start a
+new sequence (any other run of 3 would already have been removed), so a
+run of 3 is only kept if one of its blocks is dirty, and colours
+without dirty blocks are skipped altogether.
+Returns true if any block was marked.*/
+bool markMatches(Game* game) {
+    uint16_t* match = game->MatchMask;
+    uint16_t* dirty = game->DirtyMask;
+
+    // find out which colours the dirty blocks have
+    uint8_t colours = 0;
+    for (int i = 0; i < NUM_COLS; ++i) {
+        for (uint16_t bits = dirty[i]; bits != 0; bits &= bits - 1) {
+            colours |= 1 << blockAt(game, i, __builtin_ctz(bits));
+        }
+    }
+
+    for (int c = 1; c < NUM_SHADES; ++c) {
+        if ((colours & (1 << c)) == 0) { // nothing of this colour has changed
+            continue;
+        }
+        const uint16_t* m = game->ShadeMask[c];
+        uint16_t d[NUM_COLS]; // the dirty blocks of this colour
+        for (int i = 0; i < NUM_COLS; ++i) {
+            d[i] = m[i] & dirty[i];
+        }
+
+        RunFinder<NUM_COLS, NUM_ROWS, true>::find(m, d, match);
+    }
+
+    uint16_t found = 0;
+    for (int i = 0; i < NUM_COLS; ++i) {
+        found |= match[i];
+        dirty[i] = 0;
+    }
+    return found != 0;
+}
+
+/*Marks every block as dirty so the next markMatches checks the whole
+grid. Needed when the grid was filled in by something other than the
+normal landing and dropping (which leave no sequences behind).*/
+void markAllDirty(Game* game) {
+    for (int i = 0; i < NUM_COLS; ++i) {
+        game->DirtyMask[i] = (1 << NUM_ROWS) - 1;
+    }
+}
+
+/*Set the match mask back to 0 after blocks have been removed.*/
+void resetMatchMask(Game* game) {
+    memset(game->MatchMask, 0, sizeof(game->MatchMask));
+}
+
+/*Removes the marked block sequences from the grid and updates the score.
+The MatchMask is left as it is so the display can see what was removed.
+Returns the number of blocks removed.*/
+int removeMatches(Game* game) {
+    int removed = 0;
+    for (int i = 0; i < NUM_COLS; ++i) {
+        for (int j = 0; j < NUM_ROWS; ++j) {
+            if (game->MatchMask[i] & (1 << j)) {
+                setBlock(game, i, j, Black);
+                ++removed;
+            }
+        }
+    }
+    game->score = game->score + removed*game->level; // the score is incremented by the level for every block that disappears
+    return removed;
+}
+
+/*After erasing the blocks, lets every block above a gap fall as far as
+it can in one pass: each column is packed down from its lowest gap, so
+every block is written once, straight into the row it ends up in.
+moved[i] gets the cells of column i that changed (where blocks fell to
+and the rows they left), for the display to redraw. Returns true if any
+block moved, in which case the grid must be checked again.*/
+bool compactBlocks(Game* game, uint16_t moved[NUM_COLS]) {
+    bool any = false;
+    for (int i = 0; i < NUM_COLS; ++i) {
+        moved[i] = 0;
+        uint16_t filled = ~game->ShadeMask[Black][i] & ((1 << NUM_ROWS) - 1);
+        if ((filled & (filled + 1)) == 0) { // the blocks already sit at the bottom
+            continue;
+        }
+        uint16_t before[3] = {game->ColourBits[0][i], game->ColourBits[1][i], game->ColourBits[2][i]};
+        int to = __builtin_ctz(~filled); // the lowest gap
+        for (int from = to + 1; from < NUM_ROWS; ++from) {
+            if (filled & (1 << from)) {
+                setBlock(game, i, to++, blockAt(game, i, from));
+            }
+        }
+        for (; to < NUM_ROWS && (filled >> to) != 0; ++to) {
+            setBlock(game, i, to, Black); // the rows the top blocks left
+        }
+        for (int b = 0; b < 3; ++b) {
+            moved[i] |= before[b] ^ game->ColourBits[b][i];
+        }
+        any = true;
+    }
+    return any;
+}
+
+/*One step of a cascade: removes the sequences through the dirty blocks
+and lets the blocks above fall into the gaps. step, if not 0, gets the
+blocks removed, the cells that changed as blocks fell and the points
+scored, which is all the display needs to show the step. Nothing is
+drawn or waited for here. Returns true if blocks fell, in which case
+the grid must be checked again with another step.*/
+bool cascadeStep(Game* game, CascadeStep* step) {
+    CascadeStep unused;
+    if (step == 0) {
+        step = &unused;
+    }
+    int32_t before = game->score;
+    PROFILE_BEGIN(PhaseMatch);
+    bool found = markMatches(game);
+    PROFILE_END(PhaseMatch);
+    if (found) {
+        PROFILE_BEGIN(PhaseClear);
+        removeMatches(game);
+        PROFILE_END(PhaseClear);
+    }
+    memcpy(step->cleared, game->MatchMask, sizeof(step->cleared));
+    resetMatchMask(game);
+    step->points = game->score - before;
+    PROFILE_BEGIN(PhaseGravity);
+    bool fell = compactBlocks(game, step->moved);
+    PROFILE_END(PhaseGravity);
+    return fell;
+}
+
+/*Checks, removes and drops until the grid has no sequences left.
+Returns the number of times blocks were removed (the length of the cascade).*/
+int resolveCascade(Game* game) {
+    int steps = 0;
+    CascadeStep step;
+    bool fell;
+    do {
+        fell = cascadeStep(game, &step);
+        steps += step.points != 0;
+    } while (fell);
+    return steps;
+}
+
+/*Works out what landing a stack (bottom colour first) with its bottom
+block at the given row would set off, without changing game: every step
+of the cascade, as cascadeStep() takes them, the points they score and
+the grid they leave. Steps that remove nothing are left out. Returns the
+number of steps.*/
+int planLanding(const Game* game, int col, int row, const Shade stack[3], CascadePlan* plan) {
+    Game after = *game;
+    landStack(&after, col, row, stack[0], stack[1], stack[2]);
+    plan->steps = 0;
+    plan->points = 0;
+    CascadeStep step;
+    bool fell;
+    do {
+        fell = cascadeStep(&after, &step);
+        // every step removes at least 3 of the 90 blocks, so there is always room
+        if (step.points != 0 && plan->steps < MAX_CASCADE_STEPS) {
+            plan->step[plan->steps++] = step;
+            plan->points += step.points;
+        }
+    } while (fell);
+    memcpy(plan->ColourBits, after.ColourBits, sizeof(plan->ColourBits));
+    return plan->steps;
+}
+
+/*A 32 bit FNV-1a hash of the grid, score and level, so two games can be
+compared without storing the whole grid.*/
+uint32_t boardHash(const Game* game) {
+    uint32_t hash = 2166136261UL;
+    for (int i = 0; i < NUM_COLS; ++i) {
+        for (int j = 0; j < NUM_ROWS; ++j) {
+            hash = (hash ^ blockAt(game, i, j)) * 16777619UL;
+        }
+    }
+    uint32_t values[2] = {(uint32_t) game->score, (uint32_t) game->level};
+    for (int k = 0; k < 2; ++k) {
+        for (int b = 0; b < 32; b += 8) {
+            hash = (hash ^ ((values[k] >> b) & 0xFF)) * 16777619UL;
+        }
+    }
+    return hash;
+}
+
+#ifdef ZOBRIST
+/*The Zobrist hash of the grid and level worked out from scratch, which
+game->zobrist should always equal.*/
+uint64_t zobristBoard(const Game* game) {
+    uint64_t hash = levelKey(game->level);
+    for (int i = 0; i < NUM_COLS; ++i) {
+        for (int j = 0; j < NUM_ROWS; ++j) {
+            hash ^= cellKeys[i][j][blockAt(game, i, j)];
+        }
+    }
+    return hash;
+}
+
+/*The Zobrist key of a stack of three colours (bottom first), to be
+combined with game->zobrist when the stack matters too.*/
+uint64_t zobristStack(const Shade stack[3]) {
+    return stackKeys[0][stack[0]] ^ stackKeys[1][stack[1]] ^ stackKeys[2][stack[2]];
+}
+#endif
@@ -0,0 +1,110 @@
+/*The hardware-free core of MEGA Columns: the block grid and the rules
+for landing stacks, finding sequences, removing them and letting the
+blocks above fall. Nothing in here touches the TFT, the joystick or the
+clock, so the same code runs on the Arduino and on a desktop machine;
+the only exception is an Arduino build with PROFILE=1, where
+cascadeStep() reads Timer1 to time its parts (see profile.h).*/
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdint.h>
+
+#define NUM_COLS 6
+#define NUM_ROWS 15
+
+// fall speeds are fixed point, in 1/2^FALL_SHIFT pixels per microsecond
+#define FALL_SHIFT 24
+#define PIXELS_PER_SECOND(p) ((uint32_t) ((p) * 16.777216 + 0.5)) // 2^24 / 10^6
+#define DROP_SPEED PIXELS_PER_SECOND(400) // while the joystick is held down
+#define MAX_FALL_SPEED PIXELS_PER_SECOND(1000)
+
+// a variable type that indicates a colour
+// the values are indices, the display looks up the actual RGB565 value
+enum Shade {Black, Green, Blue, Orange, Magenta, Yellow, Cyan};
+
+#define NUM_SHADES 7
+
+#define DEFAULT_SEED 0x2545F491 // used instead of a seed of 0, which the generator cannot leave
+
+// Searches on the host keep a 64 bit Zobrist hash of every board. Its keys
+// take 5 KB, more than the Arduino can spare, so it is left out there.
+#ifndef __AVR__
+#define ZOBRIST
+#endif
+
+// everything the rules need to know about a game in progress
+// the colour of each block is stored as three bit planes of column masks
+// (36 bytes on the Arduino, where an array of Shades took 180), read it
+// with blockAt()
+struct Game {
+    uint16_t ColourBits[3][NUM_COLS]; // bit j of ColourBits[b][i] is bit b of the Shade of block (i, j), [0][0] is the bottom left
+    uint16_t ShadeMask[NUM_SHADES][NUM_COLS]; // bit j of ShadeMask[c][i] is set when block (i, j) is c
+    uint16_t MatchMask[NUM_COLS]; // marks consecutive colour sequences before they are removed
+    uint16_t DirtyMask[NUM_COLS]; // blocks placed or moved since the last check
+    int32_t score; // the score is proportional to the number of blocks removed
+    uint16_t level; // the stack falls faster every level
+    uint8_t difficulty; // can range from 3 to 6, indicates the number of different colours of blocks
+    uint32_t random; // the state of the generator that picks the colours of new stacks
+#ifdef ZOBRIST
+    uint64_t zobrist; // the Zobrist hash of the grid and the level, kept up to date by setBlock and nextLevel
+#endif
+};
+
+/*The colour of the block in a column and row.*/
+inline Shade blockAt(const Game* game, int col, int row) {
+    uint16_t bit = 1 << row; // one shift, the AVR shifts a bit at a time
+    return (Shade) ((game->ColourBits[0][col] & bit ? 1 : 0) | (game->ColourBits[1][col] & bit ? 2 : 0) |
+                    (game->ColourBits[2][col] & bit ? 4 : 0));
+}
+
+#define MAX_CASCADE_STEPS 30 // each step removes at least 3 of the 90 blocks
+
+// what one step of a cascade did to the grid
+struct CascadeStep {
+    uint16_t cleared[NUM_COLS]; // the blocks removed
+    uint16_t moved[NUM_COLS]; // the cells that changed as the blocks above fell
+    int32_t points; // added to the score
+};
+
+// the whole cascade set off by a landing, as planLanding() works it out
+// (its steps alone take 840 bytes, so only the host tools keep one)
+struct CascadePlan {
+    uint8_t steps;
+    int32_t points;
+    CascadeStep step[MAX_CASCADE_STEPS];
+    uint16_t ColourBits[3][NUM_COLS]; // the grid once the cascade is over
+};
+
+/*How fast the stack falls at a level, in 1/2^FALL_SHIFT pixels per microsecond.*/
+typedef uint32_t (*SpeedCurve)(int level);
+
+void resetGame(Game* game, int difficulty, uint32_t seed);
+Shade colourFromNumber(int number);
+uint32_t nextRandom(Game* game);
+Shade randomShade(Game* game);
+void randomStack(Game* game, Shade* Bcolour, Shade* Mcolour, Shade* Tcolour);
+
+void setBlock(Game* game, int col, int row, Shade colour);
+void landStack(Game* game, int col, int row, Shade Bcolour, Shade Mcolour, Shade Tcolour);
+int landingRow(const Game* game, int col);
+bool stackOverflowed(const Game* game, int col, int row);
+uint32_t fallSpeed(int level);
+void nextLevel(Game* game);
+
+bool markMatches(Game* game);
+void markAllDirty(Game* game);
+void resetMatchMask(Game* game);
+int removeMatches(Game* game);
+bool compactBlocks(Game* game, uint16_t moved[NUM_COLS]);
+bool cascadeStep(Game* game, CascadeStep* step);
+int resolveCascade(Game* game);
+int planLanding(const Game* game, int col, int row, const Shade stack[3], CascadePlan* plan);
+uint32_t boardHash(const Game* game);
+
+#ifdef ZOBRIST
+uint64_t zobristBoard(const Game* game);
+uint64_t zobristStack(const Shade stack[3]);
+#endif
+
+#endif
@@ -0,0 +1,165 @@
+#include "gamelog.h"
+
+/*Writes the lowest count bytes of value, lowest first, into out.*/
+static void putBytes(uint8_t* out, uint32_t value, int count) {
+    for (int k = 0; k < count; ++k) {
+        out[k] = value >> (8 * k);
+    }
+}
+
+/*Writes the time since the last input as a varint followed by code.*/
+static void logCode(LogWriter* log, uint32_t tick, uint8_t code) {
+    uint8_t bytes[6];
+    uint8_t count = 0;
+    uint32_t delta = tick - log->lastTick;
+    while (delta >= 0x80) {
+        bytes[count++] = (delta & 0x7F) | 0x80;
+        delta >>= 7;
+    }
+    bytes[count++] = delta;
+    bytes[count++] = code;
+    log->write(bytes, count);
+    log->lastTick = tick;
+}
+
+/*Starts the log of a new game. Call before the first tick.*/
+void logBegin(LogWriter* log, LogWrite write, int difficulty, uint32_t seed) {
+    log->write = write;
+    log->lastTick = 0;
+    uint8_t header[LOG_HEADER_SIZE] = {'M', 'C', 'L', LOG_VERSION, (uint8_t) difficulty};
+    putBytes(header + 5, seed, 4);
+    write(header, LOG_HEADER_SIZE);
+}
+
+/*Records an input given to sessionInput() before the given tick ran.*/
+void logInput(LogWriter* log, uint32_t tick, uint8_t input, int8_t value) {
+    logCode(log, tick, (input << 2) | (value + 1));
+}
+
+/*Ends the log with how the game ended.*/
+void logEnd(LogWriter* log, const Session* session) {
+    logCode(log, session->tick, LOG_END);
+    uint8_t footer[10];
+    putBytes(footer, session->game.score, 4);
+    putBytes(footer + 4, session->game.level, 2);
+    putBytes(footer + 6, boardHash(&session->game), 4);
+    log->write(footer, 10);
+}
+
+/*Reads a little endian number of count bytes. Returns false at the end of the log.*/
+static bool getBytes(Replay* replay, uint32_t* value, int count) {
+    *value = 0;
+    for (int k = 0; k < count; ++k) {
+        int byte = replay->read(replay->context);
+        if (byte < 0) {
+            return false;
+        }
+        *value |= (uint32_t) byte << (8 * k);
+    }
+    return true;
+}
+
+/*Reads the next input (or the end) and when it happens.*/
+static void readNext(Replay* replay) {
+    uint32_t delta = 0;
+    int byte;
+    int shift = 0;
+    replay->nextCode = -1;
+    do {
+        byte = replay->read(replay->context);
+        if (byte < 0 || shift > 28) {
+            return;
+        }
+        delta |= (uint32_t) (byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    int code = replay->read(replay->context);
+    if (code < 0) {
+        return;
+    }
+    replay->nextTick += delta;
+    replay->nextCode = code;
+
+    if (code == LOG_END) {
+        uint32_t score, level, hash;
+        if (!getBytes(replay, &score, 4) || !getBytes(replay, &level, 2) || !getBytes(replay, &hash, 4)) {
+            replay->nextCode = -1;
+            return;
+        }
+        replay->score = score;
+        replay->level = level;
+        replay->hash = hash;
+    }
+}
+
+/*Reads the header of a log and starts its game in session. Anything
+before the header (such as text printed on the same serial line) is
+skipped. Returns false if there is no header.*/
+bool replayBegin(Replay* replay, LogRead read, void* context, Session* session) {
+    replay->read = read;
+    replay->context = context;
+    replay->nextTick = 0;
+
+    // find 'M' 'C' 'L' and the current version
+    const uint8_t magic[3] = {'M', 'C', 'L'};
+    int matched = 0;
+    while (matched < 4) {
+        int byte = read(context);
+        if (byte < 0) {
+            return false;
+        }
+        if (byte == (matched == 3 ? LOG_VERSION : magic[matched])) {
+            ++matched;
+        }
+        else {
+            matched = byte == magic[0] ? 1 : 0;
+        }
+    }
+    uint32_t difficulty, seed;
+    if (!getBytes(replay, &difficulty, 1) || !getBytes(replay, &seed, 4) || difficulty < 3 || difficulty > 6) {
+        return false;
+    }
+    resetSession(session, difficulty, seed);
+    readNext(replay);
+    return true;
+}
+
+/*Gives the session the inputs recorded before its next tick and runs the
+tick. Returns false once the game is over or the log has ended.*/
+bool replayTick(Replay* replay, Session* session) {
+    while (replay->nextCode >= 0 && replay->nextCode != LOG_END && replay->nextTick <= session->tick) {
+        sessionInput(session, replay->nextCode >> 2, (replay->nextCode & 3) - 1);
+        readNext(replay);
+    }
+    if (session->phase == Over || replay->nextCode < 0 ||
+            (replay->nextCode == LOG_END && session->tick >= replay->nextTick)) {
+        return false;
+    }
+    sessionTick(session);
+    return true;
+}
+
+/*Compares the end of the replayed game with the end of the log. A log
+may also end before game over, when a game was stopped part way.*/
+int replayFinish(Replay* replay, const Session* session) {
+    if (replay->nextCode < 0) {
+        return ReplayTruncated;
+    }
+    if (replay->nextCode != LOG_END || session->tick != replay->nextTick ||
+            session->game.score != replay->score || session->game.level != replay->level ||
+            boardHash(&session->game) != replay->hash) {
+        return ReplayDiverged;
+    }
+    return ReplayMatched;
+}
+
+/*Replays a whole log into session. Returns a ReplayResult.*/
+int replayRun(LogRead read, void* context, Session* session) {
+    Replay replay;
+    if (!replayBegin(&replay, read, context, session)) {
+        return ReplayBadLog;
+    }
+    while (replayTick(&replay, session)) {
+    }
+    return replayFinish(&replay, session);
+}
@@ -0,0 +1,56 @@
+/*A compact binary log of a game: the seed and difficulty, every input
+that changed the game with the tick it arrived before, and the final
+score, level and board hash. Since a Session only depends on these, the
+log is enough to run the exact same game again, on the host or on the
+Arduino, and check that it ends the same way.
+
+Layout (numbers are little endian):
+  header  'M' 'C' 'L' version, difficulty (1 byte), seed (4 bytes)
+  input   ticks since the last input (varint), (input << 2) | (value + 1)
+  end     ticks since the last input (varint), LOG_END,
+          score (4 bytes), level (2 bytes), board hash (4 bytes)
+A varint is 7 bits per byte, lowest first, with the top bit set on every
+byte but the last. Most inputs take 2 bytes.
+
+The version changes whenever the rules change how a recorded game plays
+out, and only logs of the current version are replayed.*/
+
+#ifndef GAMELOG_H
+#define GAMELOG_H
+
+#include "session.h"
+
+#define LOG_VERSION 1
+#define LOG_HEADER_SIZE 9
+#define LOG_END 0xFF
+
+typedef void (*LogWrite)(const uint8_t* bytes, uint8_t count);
+typedef int (*LogRead)(void* context); // the next byte, or -1 at the end
+
+struct LogWriter {
+    LogWrite write;
+    uint32_t lastTick; // the tick of the last input written
+};
+
+enum ReplayResult {ReplayMatched, ReplayDiverged, ReplayTruncated, ReplayBadLog};
+
+struct Replay {
+    LogRead read;
+    void* context;
+    uint32_t nextTick; // the tick of the next input or of the end
+    int nextCode; // the next input, LOG_END, or -1 if the log stopped early
+    int32_t score; // from the end of the log
+    uint16_t level;
+    uint32_t hash;
+};
+
+void logBegin(LogWriter* log, LogWrite write, int difficulty, uint32_t seed);
+void logInput(LogWriter* log, uint32_t tick, uint8_t input, int8_t value);
+void logEnd(LogWriter* log, const Session* session);
+
+bool replayBegin(Replay* replay, LogRead read, void* context, Session* session);
+bool replayTick(Replay* replay, Session* session);
+int replayFinish(Replay* replay, const Session* session);
+int replayRun(LogRead read, void* context, Session* session);
+
+#endif
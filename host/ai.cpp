@@ -0,0 +1,243 @@
+#include "host/ai.h"
+
+#include <atomic>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+// what a search thread needs to know besides the board
+struct Search {
+    const Shade* next; // the NEXT stack, or 0 once it has been placed
+    Clock::time_point deadline;
+    bool limited; // there is a deadline
+    std::atomic<bool>* timedOut; // shared by all threads of a decision
+    TransTable* table;
+    long nodes;
+    long probes;
+    long hits;
+};
+
+/*The colours of a stack after the colour button has been pressed
+rotation times: each press moves the bottom colour to the top and the
+other two down, as sessionInput() does.*/
+void rotateStack(const Shade stack[3], int rotation, Shade rotated[3]) {
+    for (int k = 0; k < 3; ++k) {
+        rotated[k] = stack[(k + rotation) % 3];
+    }
+}
+
+/*Whether rotating a stack gives the same colours as a smaller rotation,
+so the placement does not need to be tried again.*/
+static bool repeatedRotation(const Shade stack[3], int rotation) {
+    Shade rotated[3];
+    for (int r = 0; r < rotation; ++r) {
+        rotateStack(stack, rotation - r, rotated);
+        if (rotated[0] == stack[0] && rotated[1] == stack[1] && rotated[2] == stack[2]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*Lands a stack in a column and runs the whole cascade. Returns the number
+of blocks removed, or -1 if the stack does not fit or ends the game.*/
+static int place(Game* game, int col, const Shade stack[3], int rotation) {
+    int row = landingRow(game, col);
+    if (row >= NUM_ROWS) {
+        return -1;
+    }
+    Shade rotated[3];
+    rotateStack(stack, rotation, rotated);
+    int before = game->score;
+    landStack(game, col, row, rotated[0], rotated[1], rotated[2]);
+    resolveCascade(game);
+    if (stackOverflowed(game, col, row)) {
+        return -1;
+    }
+    return (game->score - before) / game->level;
+}
+
+/*How promising a board is, without looking ahead: low columns are good,
+columns near the top very bad, and pairs of the same colour next to each
+other good, since one more block of that colour removes them.*/
+double evaluateBoard(const Game* game) {
+    double value = 0;
+    int heights[NUM_COLS];
+    for (int i = 0; i < NUM_COLS; ++i) {
+        heights[i] = landingRow(game, i);
+        value -= heights[i];
+        if (heights[i] > NUM_ROWS - 6) {
+            value -= 20.0 * (heights[i] - (NUM_ROWS - 6));
+        }
+        if (i > 0) {
+            value -= 0.5 * (heights[i] > heights[i-1] ? heights[i] - heights[i-1] : heights[i-1] - heights[i]);
+        }
+    }
+    for (int c = 1; c < NUM_SHADES; ++c) {
+        const uint16_t* mask = game->ShadeMask[c];
+        int pairs = 0;
+        for (int i = 0; i < NUM_COLS; ++i) {
+            pairs += __builtin_popcount(mask[i] & (mask[i] >> 1)); // vertical
+            if (i + 1 < NUM_COLS) {
+                pairs += __builtin_popcount(mask[i] & mask[i+1]); // horizontal
+                pairs += __builtin_popcount(mask[i] & (mask[i+1] >> 1)); // diagonal down
+                pairs += __builtin_popcount(mask[i] & (mask[i+1] << 1)); // diagonal up
+            }
+        }
+        value += 1.5 * pairs;
+    }
+    return value;
+}
+
+static double bestPlacement(const Game* game, const Shade stack[3], int depth, Search* search);
+
+/*The value of a board with depth stacks still to place: the best
+placement of NEXT if it has not been placed yet, otherwise the average
+over every stack randomStack() could pick of its best placement.*/
+static double lookAhead(const Game* game, int depth, Search* search) {
+    if (depth == 0) {
+        return evaluateBoard(game);
+    }
+    if (search->next != 0) {
+        const Shade* next = search->next;
+        search->next = 0;
+        double value = bestPlacement(game, next, depth, search);
+        search->next = next;
+        return value;
+    }
+    // Stacks that are rotations of each other have the same best placement,
+    // so only the smallest of each is searched, weighted by how many there are.
+    int colours = game->difficulty;
+    double total = 0;
+    int count = 0;
+    for (int a = 1; a <= colours; ++a) {
+        for (int b = 1; b <= colours; ++b) {
+            for (int c = 1; c <= colours; ++c) {
+                int code = (a * 8 + b) * 8 + c;
+                if (code > (b * 8 + c) * 8 + a || code > (c * 8 + a) * 8 + b) {
+                    continue;
+                }
+                int weight = (a == b && b == c) ? 1 : 3;
+                Shade stack[3] = {colourFromNumber(a), colourFromNumber(b), colourFromNumber(c)};
+                total += weight * bestPlacement(game, stack, depth, search);
+                count += weight;
+            }
+        }
+    }
+    return total / count;
+}
+
+/*The value of the best placement of a stack, with depth-1 stacks to
+place after it.*/
+static double placementValue(const Game* game, int col, const Shade stack[3], int rotation, int depth,
+                             Search* search) {
+    Game after = *game;
+    ++search->nodes;
+    int removed = place(&after, col, stack, rotation);
+    if (removed < 0) {
+        return AI_DEAD;
+    }
+    return 10.0 * removed + lookAhead(&after, depth - 1, search);
+}
+
+static double bestPlacement(const Game* game, const Shade stack[3], int depth, Search* search) {
+    if (search->limited && (search->timedOut->load(std::memory_order_relaxed) || Clock::now() > search->deadline)) {
+        search->timedOut->store(true, std::memory_order_relaxed);
+        return 0;
+    }
+    // game->zobrist covers the grid and the level. Every rotation of the
+    // stack is tried, so all three share one key: the smallest of theirs.
+    uint64_t stackKey = zobristStack(stack);
+    for (int rotation = 1; rotation < AI_ROTATIONS; ++rotation) {
+        Shade rotated[3];
+        rotateStack(stack, rotation, rotated);
+        uint64_t rotatedKey = zobristStack(rotated);
+        if (rotatedKey < stackKey) {
+            stackKey = rotatedKey;
+        }
+    }
+    uint64_t key = game->zobrist ^ stackKey;
+    double best = AI_DEAD;
+    if (search->table != 0) {
+        ++search->probes;
+        if (search->table->probe(key, depth, &best)) {
+            ++search->hits;
+            return best;
+        }
+    }
+    for (int rotation = 0; rotation < AI_ROTATIONS; ++rotation) {
+        if (repeatedRotation(stack, rotation)) {
+            continue;
+        }
+        for (int col = 0; col < NUM_COLS; ++col) {
+            double value = placementValue(game, col, stack, rotation, depth, search);
+            if (value > best) {
+                best = value;
+            }
+        }
+    }
+    if (search->table != 0 && !search->timedOut->load(std::memory_order_relaxed)) {
+        search->table->store(key, depth, best);
+    }
+    return best;
+}
+
+/*Picks the placement of the current stack with the best value, searching
+deeper until settings->depth is reached or the time budget runs out.
+With no pool the search runs on the calling thread, for callers that
+already keep every core busy with games of their own.*/
+AiChoice choosePlacement(WorkPool* pool, const Game* game, const Shade current[3], const Shade next[3],
+                         const AiSettings* settings) {
+    AiChoice choice = {0, 0, AI_DEAD, 0, 0, 0, 0};
+    std::atomic<bool> timedOut(false);
+    Clock::time_point deadline = Clock::now() +
+        std::chrono::microseconds((long long) (settings->budgetMs * 1000));
+    std::atomic<long> nodes(0);
+    std::atomic<long> probes(0);
+    std::atomic<long> hits(0);
+    if (settings->table != 0) {
+        settings->table->newAge();
+    }
+
+    for (int depth = 1; depth <= settings->depth; ++depth) {
+        double values[AI_PLACEMENTS];
+        auto searchPlacement = [&](size_t n) {
+            int col = n % NUM_COLS;
+            int rotation = n / NUM_COLS;
+            if (repeatedRotation(current, rotation)) {
+                values[n] = AI_DEAD - 1;
+                return;
+            }
+            // the first depth always finishes, so there is always a choice
+            Search search = {next, deadline, depth > 1 && settings->budgetMs > 0, &timedOut, settings->table, 0, 0, 0};
+            values[n] = placementValue(game, col, current, rotation, depth, &search);
+            nodes += search.nodes;
+            probes += search.probes;
+            hits += search.hits;
+        };
+        if (pool != 0) {
+            pool->run(AI_PLACEMENTS, searchPlacement);
+        }
+        else {
+            for (size_t n = 0; n < AI_PLACEMENTS; ++n) {
+                searchPlacement(n);
+            }
+        }
+        if (timedOut) {
+            break; // this depth is incomplete, keep the last one
+        }
+        choice.value = values[0] - 1;
+        for (int n = 0; n < AI_PLACEMENTS; ++n) {
+            if (values[n] > choice.value) {
+                choice.value = values[n];
+                choice.col = n % NUM_COLS;
+                choice.rotation = n / NUM_COLS;
+            }
+        }
+        choice.depth = depth;
+    }
+    choice.nodes = nodes;
+    choice.probes = probes;
+    choice.hits = hits;
+    return choice;
+}
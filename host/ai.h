@@ -0,0 +1,50 @@
+/*A computer player for automated play-testing on the host. It picks the
+column and rotation for the falling stack by trying every placement of
+it (6 columns, 3 rotations), then of the NEXT stack shown in the preview,
+running the full cascade for each, and scoring the boards that result.
+Deeper searches add chance nodes: the colours of the stacks after NEXT
+are not known yet, so each placement is valued at the average, over all
+the stacks randomStack() could pick, of the best placement of that stack
+(expectimax).
+
+The placements at the top of the search are shared out over a WorkPool,
+and the search deepens one stack at a time until it reaches the depth
+asked for or runs out of its time budget, in which case the result of
+the last depth it finished is used. The best placement of a stack on a
+board at a given depth is the same however the board came about, so it
+is kept in a transposition table, which also carries over to the next
+decision: most of the boards one stack ahead have been searched already.*/
+
+#ifndef HOST_AI_H
+#define HOST_AI_H
+
+#include "engine.h"
+#include "host/threadpool.h"
+#include "host/ttable.h"
+
+#define AI_ROTATIONS 3
+#define AI_PLACEMENTS (NUM_COLS * AI_ROTATIONS)
+#define AI_DEAD -1e9 // the value of a placement that ends the game
+
+struct AiSettings {
+    int depth; // stacks to look ahead: 1 = just this one, 2 = and NEXT, 3 or more = and random ones after that
+    double budgetMs; // the time allowed for one decision, 0 for no limit
+    TransTable* table; // positions already searched, or 0 to search everything
+};
+
+struct AiChoice {
+    int col;
+    int rotation; // how many times the colour button is pressed
+    double value;
+    int depth; // the depth the choice comes from
+    long nodes; // placements tried, over all depths and threads
+    long probes; // positions looked up in the table
+    long hits; // and found there
+};
+
+void rotateStack(const Shade stack[3], int rotation, Shade rotated[3]);
+double evaluateBoard(const Game* game);
+AiChoice choosePlacement(WorkPool* pool, const Game* game, const Shade current[3], const Shade next[3],
+                         const AiSettings* settings);
+
+#endif
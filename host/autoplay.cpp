@@ -0,0 +1,143 @@
+/*Lets the computer player in ai.cpp play whole games through a Session,
+the way a person would: when a stack comes in it decides where it should
+go, presses the colour button for the rotation, holds the joystick
+towards the column and holds it down once the stack is there. Every
+input goes into a game log like the ones the Arduino writes, so with -o
+the games can be checked with verify and followed with replay -t.
+
+Reports the average score, level and number of stacks per game, how
+often a stack did not end up where the player wanted (a column in the
+way, or too little time at high levels), and how many decisions were
+made per second. -t sets the size of the transposition table in MB,
+0 turns it off.
+
+Usage: autoplay [-g games] [-d depth] [-b budget ms] [-j threads]
+                [-m max stacks] [-l difficulty] [-t table MB] [-o directory]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "gamelog.h"
+#include "host/player.h"
+
+static std::vector<uint8_t> recording;
+
+static void writeRecording(const uint8_t* bytes, uint8_t count) {
+    recording.insert(recording.end(), bytes, bytes + count);
+}
+
+struct Totals {
+    long long score;
+    long long level;
+    long long stacks;
+    long long missed;
+    long long decisions;
+    long long nodes;
+    long long probes;
+    long long hits;
+    double thinking; // seconds spent choosing placements
+};
+
+static void playGame(WorkPool* pool, const AiSettings* settings, int difficulty, uint32_t seed, int maxStacks,
+                     Totals* totals) {
+    static Session session;
+    LogWriter log;
+    recording.clear();
+    if (settings->table != 0) {
+        settings->table->clear(); // values depend on the difficulty, which is not in the hash
+    }
+    resetSession(&session, difficulty, seed);
+    logBegin(&log, writeRecording, difficulty, seed);
+    Player player;
+    resetPlayer(&player, AiPolicy, settings, pool, 0, seed);
+    player.log = &log;
+    while (session.phase != Over && session.stacks <= maxStacks) {
+        playerTick(&player, &session);
+    }
+    logEnd(&log, &session);
+    totals->score += session.game.score;
+    totals->level += session.game.level;
+    totals->stacks += session.stacks;
+    totals->missed += player.missed;
+    totals->decisions += player.decisions;
+    totals->nodes += player.nodes;
+    totals->probes += player.probes;
+    totals->hits += player.hits;
+    totals->thinking += player.thinking;
+}
+
+int main(int argc, char** argv) {
+    int games = 20;
+    AiSettings settings = {2, 50, 0};
+    int tableMegabytes = 64;
+    unsigned threads = 0;
+    int maxStacks = 1000;
+    int difficulty = 4;
+    const char* directory = 0;
+    for (int k = 1; k + 1 < argc; k += 2) {
+        if (strcmp(argv[k], "-g") == 0) {
+            games = atoi(argv[k + 1]);
+        }
+        else if (strcmp(argv[k], "-d") == 0) {
+            settings.depth = atoi(argv[k + 1]);
+        }
+        else if (strcmp(argv[k], "-b") == 0) {
+            settings.budgetMs = atof(argv[k + 1]);
+        }
+        else if (strcmp(argv[k], "-j") == 0) {
+            threads = atoi(argv[k + 1]);
+        }
+        else if (strcmp(argv[k], "-m") == 0) {
+            maxStacks = atoi(argv[k + 1]);
+        }
+        else if (strcmp(argv[k], "-l") == 0) {
+            difficulty = atoi(argv[k + 1]);
+        }
+        else if (strcmp(argv[k], "-t") == 0) {
+            tableMegabytes = atoi(argv[k + 1]);
+        }
+        else if (strcmp(argv[k], "-o") == 0) {
+            directory = argv[k + 1];
+        }
+    }
+    if (difficulty < 3 || difficulty > 6 || settings.depth < 1) {
+        fprintf(stderr, "difficulty must be between 3 and 6 and depth at least 1\n");
+        return 2;
+    }
+
+    WorkPool pool(threads);
+    TransTable* table = tableMegabytes > 0 ? new TransTable(tableMegabytes) : 0;
+    settings.table = table;
+    Totals totals;
+    memset(&totals, 0, sizeof(totals));
+    for (int n = 0; n < games; ++n) {
+        playGame(&pool, &settings, difficulty, n + 1, maxStacks, &totals);
+        if (directory != 0) {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/A%05d.LOG", directory, n);
+            FILE* file = fopen(path, "wb");
+            if (file == 0) {
+                perror(path);
+                return 1;
+            }
+            fwrite(recording.data(), 1, recording.size(), file);
+            fclose(file);
+        }
+    }
+
+    printf("%d games, difficulty %d, depth %d, budget %.0f ms, %u threads\n", games, difficulty, settings.depth,
+           settings.budgetMs, pool.size());
+    printf("average score %.1f, level %.1f, stacks %.1f, %.1f%% of stacks missed their column\n",
+           (double) totals.score / games, (double) totals.level / games, (double) totals.stacks / games,
+           100.0 * totals.missed / totals.decisions);
+    printf("%lld decisions, %.0f per second, %.0f placements tried per second\n",
+           totals.decisions, totals.decisions / totals.thinking, totals.nodes / totals.thinking);
+    if (table != 0) {
+        printf("transposition table %zu MB, %lld probes, %.1f%% hits\n", table->sizeBytes() >> 20, totals.probes,
+               100.0 * totals.hits / totals.probes);
+        delete table;
+    }
+    return 0;
+}
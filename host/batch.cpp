@@ -0,0 +1,253 @@
+#include "host/batch.h"
+
+#include <immintrin.h>
+
+#define FULL_COLUMN ((1 << NUM_ROWS) - 1)
+
+static inline uint16_t* maskArray(BoardBatch* batch, int colour, int col) {
+    return &batch->masks[((colour - 1) * NUM_COLS + col) * batch->count];
+}
+
+static inline const uint16_t* maskArray(const BoardBatch* batch, int colour, int col) {
+    return &batch->masks[((colour - 1) * NUM_COLS + col) * batch->count];
+}
+
+/*Makes room for boards boards, all empty.*/
+void batchResize(BoardBatch* batch, size_t boards) {
+    batch->count = (boards + BATCH_LANES - 1) / BATCH_LANES * BATCH_LANES;
+    batch->masks.assign(BATCH_COLOURS * NUM_COLS * batch->count, 0);
+    batch->removed.assign(batch->count, 0);
+    batch->steps.assign(batch->count, 0);
+}
+
+/*Copies the grid of a game into the batch.*/
+void batchLoad(BoardBatch* batch, size_t board, const Game* game) {
+    for (int c = 1; c <= BATCH_COLOURS; ++c) {
+        for (int i = 0; i < NUM_COLS; ++i) {
+            maskArray(batch, c, i)[board] = game->ShadeMask[c][i];
+        }
+    }
+}
+
+/*The colour of one block of a board in the batch.*/
+Shade batchCell(const BoardBatch* batch, size_t board, int col, int row) {
+    for (int c = 1; c <= BATCH_COLOURS; ++c) {
+        if (maskArray(batch, c, col)[board] & (1 << row)) {
+            return (Shade) c;
+        }
+    }
+    return Black;
+}
+
+/*Resolves one board held as masks m[colour-1][col], the way
+batchResolveAvx2() does 16 at a time.*/
+static void resolveOne(uint16_t m[BATCH_COLOURS][NUM_COLS], uint16_t* removed, uint8_t* steps) {
+    *removed = 0;
+    *steps = 0;
+    while (true) {
+        uint16_t match[NUM_COLS] = {0};
+        for (int c = 0; c < BATCH_COLOURS; ++c) {
+            for (int i = 0; i < NUM_COLS; ++i) {
+                uint16_t v = m[c][i] & (m[c][i] >> 1) & (m[c][i] >> 2);
+                match[i] |= v | (v << 1) | (v << 2);
+            }
+            for (int i = 0; i + 2 < NUM_COLS; ++i) {
+                uint16_t h = m[c][i] & m[c][i+1] & m[c][i+2];
+                uint16_t r = m[c][i] & (m[c][i+1] >> 1) & (m[c][i+2] >> 2);
+                uint16_t l = m[c][i] & (m[c][i+1] << 1) & (m[c][i+2] << 2);
+                match[i] |= h | r | l;
+                match[i+1] |= h | (r << 1) | (l >> 1);
+                match[i+2] |= h | (r << 2) | (l >> 2);
+            }
+        }
+        uint16_t any = 0;
+        for (int i = 0; i < NUM_COLS; ++i) {
+            any |= match[i];
+        }
+        if (any == 0) {
+            return;
+        }
+        ++*steps;
+        for (int i = 0; i < NUM_COLS; ++i) {
+            *removed += __builtin_popcount(match[i] & FULL_COLUMN);
+            uint16_t occupied = 0;
+            for (int c = 0; c < BATCH_COLOURS; ++c) {
+                m[c][i] &= ~match[i];
+                occupied |= m[c][i];
+            }
+            // the move masks of compress(x, occupied), Hacker's Delight 7-4
+            uint16_t mv[4];
+            uint16_t mk = ~occupied << 1;
+            uint16_t mask = occupied;
+            for (int s = 0; s < 4; ++s) {
+                uint16_t mp = mk ^ (mk << 1);
+                mp ^= mp << 2;
+                mp ^= mp << 4;
+                mp ^= mp << 8;
+                mv[s] = mp & mask;
+                mask = (mask ^ mv[s]) | (mv[s] >> (1 << s));
+                mk &= ~mp;
+            }
+            for (int c = 0; c < BATCH_COLOURS; ++c) {
+                uint16_t x = m[c][i];
+                for (int s = 0; s < 4; ++s) {
+                    uint16_t t = x & mv[s];
+                    x = (x ^ t) | (t >> (1 << s));
+                }
+                m[c][i] = x;
+            }
+        }
+    }
+}
+
+/*Resolves every board in the batch one at a time.*/
+void batchResolveScalar(BoardBatch* batch) {
+    for (size_t n = 0; n < batch->count; ++n) {
+        uint16_t m[BATCH_COLOURS][NUM_COLS];
+        for (int c = 1; c <= BATCH_COLOURS; ++c) {
+            for (int i = 0; i < NUM_COLS; ++i) {
+                m[c-1][i] = maskArray(batch, c, i)[n];
+            }
+        }
+        resolveOne(m, &batch->removed[n], &batch->steps[n]);
+        for (int c = 1; c <= BATCH_COLOURS; ++c) {
+            for (int i = 0; i < NUM_COLS; ++i) {
+                maskArray(batch, c, i)[n] = m[c-1][i];
+            }
+        }
+    }
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+/*The number of bits set in each 16 bit lane.*/
+AVX2 static inline __m256i popcount16(__m256i v) {
+    const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                           0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nibble = _mm256_set1_epi8(0x0F);
+    __m256i low = _mm256_shuffle_epi8(table, _mm256_and_si256(v, nibble));
+    __m256i high = _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble));
+    __m256i bytes = _mm256_add_epi8(low, high);
+    return _mm256_add_epi16(_mm256_and_si256(bytes, _mm256_set1_epi16(0x00FF)), _mm256_srli_epi16(bytes, 8));
+}
+
+// one step of the compress, moving the bits in mv down by s
+#define COMPRESS_STEP(x, mv, s) \
+    do { \
+        __m256i t = _mm256_and_si256(x, mv); \
+        x = _mm256_or_si256(_mm256_xor_si256(x, t), _mm256_srli_epi16(t, s)); \
+    } while (0)
+
+// one step of working out the move masks, for a shift of s
+#define MOVE_MASK(s, k) \
+    do { \
+        __m256i mp = _mm256_xor_si256(mk, _mm256_slli_epi16(mk, 1)); \
+        mp = _mm256_xor_si256(mp, _mm256_slli_epi16(mp, 2)); \
+        mp = _mm256_xor_si256(mp, _mm256_slli_epi16(mp, 4)); \
+        mp = _mm256_xor_si256(mp, _mm256_slli_epi16(mp, 8)); \
+        mv[k] = _mm256_and_si256(mp, mask); \
+        mask = _mm256_or_si256(_mm256_xor_si256(mask, mv[k]), _mm256_srli_epi16(mv[k], s)); \
+        mk = _mm256_andnot_si256(mp, mk); \
+    } while (0)
+
+/*Resolves 16 boards at a time with AVX2. Boards that are done early carry
+on through the steps of the others without changing.*/
+AVX2 void batchResolveAvx2(BoardBatch* batch) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi16(1);
+    for (size_t n = 0; n < batch->count; n += BATCH_LANES) {
+        __m256i m[BATCH_COLOURS][NUM_COLS];
+        for (int c = 0; c < BATCH_COLOURS; ++c) {
+            for (int i = 0; i < NUM_COLS; ++i) {
+                m[c][i] = _mm256_loadu_si256((const __m256i*) (maskArray(batch, c + 1, i) + n));
+            }
+        }
+        __m256i removed = zero;
+        __m256i steps = zero;
+        while (true) {
+            __m256i match[NUM_COLS];
+            for (int i = 0; i < NUM_COLS; ++i) {
+                match[i] = zero;
+            }
+            for (int c = 0; c < BATCH_COLOURS; ++c) {
+                const __m256i* k = m[c];
+                for (int i = 0; i < NUM_COLS; ++i) {
+                    __m256i v = _mm256_and_si256(k[i], _mm256_and_si256(_mm256_srli_epi16(k[i], 1),
+                                                                        _mm256_srli_epi16(k[i], 2)));
+                    match[i] = _mm256_or_si256(match[i], _mm256_or_si256(v, _mm256_or_si256(
+                                   _mm256_slli_epi16(v, 1), _mm256_slli_epi16(v, 2))));
+                }
+                for (int i = 0; i + 2 < NUM_COLS; ++i) {
+                    __m256i h = _mm256_and_si256(k[i], _mm256_and_si256(k[i+1], k[i+2]));
+                    __m256i r = _mm256_and_si256(k[i], _mm256_and_si256(_mm256_srli_epi16(k[i+1], 1),
+                                                                        _mm256_srli_epi16(k[i+2], 2)));
+                    __m256i l = _mm256_and_si256(k[i], _mm256_and_si256(_mm256_slli_epi16(k[i+1], 1),
+                                                                        _mm256_slli_epi16(k[i+2], 2)));
+                    match[i] = _mm256_or_si256(match[i], _mm256_or_si256(h, _mm256_or_si256(r, l)));
+                    match[i+1] = _mm256_or_si256(match[i+1], _mm256_or_si256(h, _mm256_or_si256(
+                                     _mm256_slli_epi16(r, 1), _mm256_srli_epi16(l, 1))));
+                    match[i+2] = _mm256_or_si256(match[i+2], _mm256_or_si256(h, _mm256_or_si256(
+                                     _mm256_slli_epi16(r, 2), _mm256_srli_epi16(l, 2))));
+                }
+            }
+            __m256i any = zero;
+            for (int i = 0; i < NUM_COLS; ++i) {
+                match[i] = _mm256_and_si256(match[i], _mm256_set1_epi16(FULL_COLUMN));
+                any = _mm256_or_si256(any, match[i]);
+            }
+            if (_mm256_testz_si256(any, any)) {
+                break;
+            }
+            // one more step for the boards that had a match
+            steps = _mm256_add_epi16(steps, _mm256_andnot_si256(_mm256_cmpeq_epi16(any, zero), one));
+
+            for (int i = 0; i < NUM_COLS; ++i) {
+                removed = _mm256_add_epi16(removed, popcount16(match[i]));
+                __m256i occupied = zero;
+                for (int c = 0; c < BATCH_COLOURS; ++c) {
+                    m[c][i] = _mm256_andnot_si256(match[i], m[c][i]);
+                    occupied = _mm256_or_si256(occupied, m[c][i]);
+                }
+                __m256i mv[4];
+                __m256i mask = occupied;
+                __m256i mk = _mm256_slli_epi16(_mm256_xor_si256(occupied, _mm256_set1_epi16(-1)), 1);
+                MOVE_MASK(1, 0);
+                MOVE_MASK(2, 1);
+                MOVE_MASK(4, 2);
+                MOVE_MASK(8, 3);
+                for (int c = 0; c < BATCH_COLOURS; ++c) {
+                    COMPRESS_STEP(m[c][i], mv[0], 1);
+                    COMPRESS_STEP(m[c][i], mv[1], 2);
+                    COMPRESS_STEP(m[c][i], mv[2], 4);
+                    COMPRESS_STEP(m[c][i], mv[3], 8);
+                }
+            }
+        }
+
+        for (int c = 0; c < BATCH_COLOURS; ++c) {
+            for (int i = 0; i < NUM_COLS; ++i) {
+                _mm256_storeu_si256((__m256i*) (maskArray(batch, c + 1, i) + n), m[c][i]);
+            }
+        }
+        uint16_t laneSteps[BATCH_LANES];
+        _mm256_storeu_si256((__m256i*) &batch->removed[n], removed);
+        _mm256_storeu_si256((__m256i*) laneSteps, steps);
+        for (int k = 0; k < BATCH_LANES; ++k) {
+            batch->steps[n + k] = laneSteps[k];
+        }
+    }
+}
+
+bool batchHasAvx2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+/*Resolves every board in the batch, with AVX2 if there is any.*/
+void batchResolve(BoardBatch* batch) {
+    if (batchHasAvx2()) {
+        batchResolveAvx2(batch);
+    }
+    else {
+        batchResolveScalar(batch);
+    }
+}
@@ -0,0 +1,49 @@
+/*Many 6x15 boards at once, for searches and Monte Carlo runs on the host
+that have lots of independent boards to resolve.
+
+The boards are kept as a structure of arrays: for every colour and
+column there is one array with that column's mask (as in Game's
+ShadeMask) for every board, so 16 boards sit side by side in one 256 bit
+AVX2 register and every step of the rules is done for all 16 with the
+same instructions:
+  - finding runs of 3 is the same shifts and ANDs as markMatches, with
+    every block counting as dirty
+  - removing them is an AND with the inverted match masks, and the
+    blocks removed are counted with a nibble lookup table
+  - the blocks above fall into the gaps by compressing every colour mask
+    of a column by the mask of its occupied cells, with the parallel
+    compress of Hacker's Delight (7-4), whose four move masks depend only
+    on the occupied cells and so are worked out once per column
+batchResolve() uses AVX2 if the processor has it and otherwise the same
+steps one board at a time. Both give the same grid, number of blocks
+removed and cascade length as copying the board into a Game and calling
+markAllDirty() and resolveCascade().*/
+
+#ifndef HOST_BATCH_H
+#define HOST_BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "engine.h"
+
+#define BATCH_LANES 16 // boards per AVX2 register
+#define BATCH_COLOURS (NUM_SHADES - 1)
+
+struct BoardBatch {
+    size_t count; // boards, rounded up to a multiple of BATCH_LANES
+    std::vector<uint16_t> masks; // masks[(colour-1) * NUM_COLS + col][board], flattened
+    std::vector<uint16_t> removed; // blocks removed from each board by the last batchResolve
+    std::vector<uint8_t> steps; // and how many times blocks were removed
+};
+
+void batchResize(BoardBatch* batch, size_t boards);
+void batchLoad(BoardBatch* batch, size_t board, const Game* game);
+Shade batchCell(const BoardBatch* batch, size_t board, int col, int row);
+void batchResolveScalar(BoardBatch* batch);
+void batchResolveAvx2(BoardBatch* batch);
+bool batchHasAvx2();
+void batchResolve(BoardBatch* batch);
+
+#endif
@@ -0,0 +1,182 @@
+/*Checks the batch resolver of batch.h against the engine and measures how
+many boards a second each of them resolves on one core.
+
+Two pools of boards are used: ones from games of random stacks, each with
+the last stack landed but not yet resolved (what a search looks at), and
+columns of random blocks, which nearly always cascade. Every board of
+both pools is resolved by the engine (copy the Game, markAllDirty(),
+resolveCascade()), by the batch one board at a time and by the batch
+with AVX2, and the grids, blocks removed and cascade lengths have to be
+the same.
+
+Usage: batchbench [seconds] [difficulty]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "host/batch.h"
+
+const int POOL = 4096;
+
+/*Fills the pool with boards from random games, each with one more stack
+landed on it.*/
+static void fromGames(std::vector<Game>* pool, int difficulty, std::mt19937* rng) {
+    Game game;
+    resetGame(&game, difficulty, 17);
+    for (size_t n = 0; n < pool->size(); ++n) {
+        int col, row;
+        Shade B, M, T;
+        for (int k = (*rng)() % 4; k >= 0; --k) {
+            col = (*rng)() % NUM_COLS;
+            row = landingRow(&game, col);
+            randomStack(&game, &B, &M, &T);
+            landStack(&game, col, row, B, M, T);
+            resolveCascade(&game);
+            if (stackOverflowed(&game, col, row) || row >= NUM_ROWS) {
+                resetGame(&game, difficulty, game.random);
+            }
+        }
+        (*pool)[n] = game;
+        col = (*rng)() % NUM_COLS;
+        randomStack(&game, &B, &M, &T);
+        landStack(&(*pool)[n], col, landingRow(&game, col), B, M, T);
+    }
+}
+
+/*Fills the pool with columns of random blocks, as bench does.*/
+static void randomColumns(std::vector<Game>* pool, int difficulty, std::mt19937* rng) {
+    for (size_t n = 0; n < pool->size(); ++n) {
+        resetGame(&(*pool)[n], difficulty, n + 1);
+        for (int i = 0; i < NUM_COLS; ++i) {
+            int height = (*rng)() % (NUM_ROWS + 1);
+            for (int j = 0; j < height; ++j) {
+                setBlock(&(*pool)[n], i, j, colourFromNumber((*rng)() % difficulty + 1));
+            }
+        }
+    }
+}
+
+/*Returns the first board on which the batch and the engine differ, or -1.*/
+static long compare(const std::vector<Game>& pool, const BoardBatch& batch) {
+    for (size_t n = 0; n < pool.size(); ++n) {
+        Game game = pool[n];
+        markAllDirty(&game);
+        int32_t before = game.score;
+        int steps = resolveCascade(&game);
+        bool same = steps == batch.steps[n] && (game.score - before) / game.level == batch.removed[n];
+        for (int i = 0; i < NUM_COLS; ++i) {
+            for (int j = 0; j < NUM_ROWS; ++j) {
+                same = same && blockAt(&game, i, j) == batchCell(&batch, n, i, j);
+            }
+        }
+        if (!same) {
+            return n;
+        }
+    }
+    return -1;
+}
+
+typedef std::chrono::steady_clock Clock;
+
+static double engineRate(const std::vector<Game>& pool, double seconds) {
+    long long boards = 0;
+    long long sink = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds) {
+        for (size_t n = 0; n < pool.size(); ++n) {
+            Game game = pool[n];
+            markAllDirty(&game);
+            sink += resolveCascade(&game);
+        }
+        boards += pool.size();
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return sink >= 0 ? boards / elapsed : 0;
+}
+
+/*Boards per second for a batch resolver, counting the copy of the
+boards into the batch as the engine's rate counts its copy of the Game.*/
+static double batchRate(const BoardBatch& loaded, void (*resolve)(BoardBatch*), double seconds) {
+    BoardBatch batch = loaded;
+    long long boards = 0;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds) {
+        memcpy(&batch.masks[0], &loaded.masks[0], loaded.masks.size() * sizeof(uint16_t));
+        resolve(&batch);
+        boards += batch.count;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return boards / elapsed;
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    int difficulty = argc > 2 ? atoi(argv[2]) : 4;
+    if (difficulty < 3 || difficulty > 6) {
+        fprintf(stderr, "difficulty must be between 3 and 6\n");
+        return 1;
+    }
+    bool avx2 = batchHasAvx2();
+    if (!avx2) {
+        printf("this processor has no AVX2, only the scalar batch is measured\n");
+    }
+
+    std::mt19937 rng(274);
+    std::vector<Game> pool(POOL);
+    bool same = true;
+    for (int kind = 0; kind < 2; ++kind) {
+        if (kind == 0) {
+            fromGames(&pool, difficulty, &rng);
+        }
+        else {
+            randomColumns(&pool, difficulty, &rng);
+        }
+        BoardBatch loaded;
+        batchResize(&loaded, POOL);
+        long cascades = 0;
+        for (int n = 0; n < POOL; ++n) {
+            batchLoad(&loaded, n, &pool[n]);
+        }
+
+        BoardBatch batch = loaded;
+        batchResolveScalar(&batch);
+        long differ = compare(pool, batch);
+        for (int n = 0; n < POOL; ++n) {
+            cascades += batch.steps[n] > 0;
+        }
+        if (differ >= 0) {
+            printf("scalar batch and engine differ on board %ld\n", differ);
+            same = false;
+        }
+        if (avx2) {
+            batch = loaded;
+            batchResolveAvx2(&batch);
+            differ = compare(pool, batch);
+            if (differ >= 0) {
+                printf("AVX2 batch and engine differ on board %ld\n", differ);
+                same = false;
+            }
+        }
+
+        printf("%s, difficulty %d, %d boards, %ld with a cascade\n", kind == 0 ? "boards from games" : "random columns",
+               difficulty, POOL, cascades);
+        double engine = engineRate(pool, seconds);
+        double scalar = batchRate(loaded, batchResolveScalar, seconds);
+        printf("  engine        %10.0f boards per second\n", engine);
+        printf("  scalar batch  %10.0f boards per second  (%.1fx)\n", scalar, scalar / engine);
+        if (avx2) {
+            double vector = batchRate(loaded, batchResolveAvx2, seconds);
+            printf("  AVX2 batch    %10.0f boards per second  (%.1fx)\n", vector, vector / engine);
+        }
+    }
+    if (same) {
+        printf("\nthe batch matches the engine on every board\n");
+    }
+    return same ? 0 : 1;
+}
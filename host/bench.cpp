@@ -0,0 +1,91 @@
+/*Host benchmark for the game engine. Drops random stacks into random
+columns as fast as possible, resolving every cascade, and reports how
+many stacks were placed and how many cascades were resolved per second.
+A new game is started whenever the grid fills up. It then runs the
+match detector alone over a pool of random boards.
+
+Usage: bench [seconds] [difficulty]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+
+#include "engine.h"
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 2.0;
+    int difficulty = argc > 2 ? atoi(argv[2]) : 4;
+    if (difficulty < 3 || difficulty > 6) {
+        fprintf(stderr, "difficulty must be between 3 and 6\n");
+        return 1;
+    }
+
+    std::mt19937 rng(274); // picks the columns, the engine picks the colours
+    Game game;
+    resetGame(&game, difficulty, 274);
+
+    long long stacks = 0;
+    long long cascades = 0;
+    long long blocks = 0;
+    long long games = 1;
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds) {
+        // check the clock every so often so it does not dominate the timing
+        for (int n = 0; n < 1024; ++n) {
+            int col = rng() % NUM_COLS;
+            int row = landingRow(&game, col);
+            Shade B, M, T;
+            randomStack(&game, &B, &M, &T);
+
+            int before = game.score;
+            landStack(&game, col, row, B, M, T);
+            cascades += resolveCascade(&game);
+            blocks += (game.score - before) / game.level;
+            ++stacks;
+
+            if (stackOverflowed(&game, col, row) || row >= NUM_ROWS) {
+                resetGame(&game, difficulty, game.random); // carry on with the same sequence
+                ++games;
+            }
+        }
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    printf("difficulty %d, %.2f s, %lld games\n", difficulty, elapsed, games);
+    printf("stacks placed:     %12lld  (%.0f per second)\n", stacks, stacks / elapsed);
+    printf("cascades resolved: %12lld  (%.0f per second)\n", cascades, cascades / elapsed);
+    printf("blocks removed:    %12lld  (%.0f per second)\n", blocks, blocks / elapsed);
+
+    // fill a pool of boards with random columns of blocks
+    const int POOL = 4096;
+    static Game pool[POOL];
+    for (int n = 0; n < POOL; ++n) {
+        resetGame(&pool[n], difficulty, n + 1);
+        for (int i = 0; i < NUM_COLS; ++i) {
+            int height = rng() % (NUM_ROWS + 1);
+            for (int j = 0; j < height; ++j) {
+                setBlock(&pool[n], i, j, colourFromNumber(rng() % difficulty + 1));
+            }
+        }
+    }
+
+    long long boards = 0;
+    long long matched = 0;
+    start = Clock::now();
+    elapsed = 0;
+    while (elapsed < seconds) {
+        for (int n = 0; n < POOL; ++n) {
+            markAllDirty(&pool[n]); // a full check, not just what changed
+            matched += markMatches(&pool[n]);
+            resetMatchMask(&pool[n]);
+        }
+        boards += POOL;
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    printf("boards checked:    %12lld  (%.0f per second, %lld had a match)\n", boards, boards / elapsed, matched);
+    return 0;
+}
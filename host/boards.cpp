@@ -0,0 +1,109 @@
+/*Plays the same random stacks on the engine's 6x15 Game and on a
+Board<6, 15, C> from board.h and checks after every stack that both have
+the same grid and score, then measures how fast boards of other sizes
+and colour counts resolve cascades. Each size is its own template
+instance, so none of them pays for the others being possible.
+
+Usage: boards [seconds per board]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+
+#include "engine.h"
+#include "board.h"
+
+/*Returns the number of stacks after which the two boards first differed,
+or -1 if they never did.*/
+template <int C>
+static long compareWithEngine(long stacks) {
+    std::mt19937 rng(C);
+    Game game;
+    resetGame(&game, C, 1);
+    Board<NUM_COLS, NUM_ROWS, C> board;
+    board.clear();
+    for (long n = 0; n < stacks; ++n) {
+        int col = rng() % NUM_COLS;
+        uint8_t stack[3];
+        for (int k = 0; k < 3; ++k) {
+            stack[k] = rng() % C + 1;
+        }
+        int row = landingRow(&game, col);
+        landStack(&game, col, row, (Shade) stack[0], (Shade) stack[1], (Shade) stack[2]);
+        resolveCascade(&game);
+        board.land(col, stack);
+        board.resolve();
+
+        bool same = game.score == board.score;
+        for (int i = 0; i < NUM_COLS; ++i) {
+            for (int j = 0; j < NUM_ROWS; ++j) {
+                same = same && blockAt(&game, i, j) == board.cells[i][j];
+            }
+        }
+        if (!same) {
+            return n;
+        }
+        if (stackOverflowed(&game, col, row) || row >= NUM_ROWS) {
+            resetGame(&game, C, 1);
+            board.clear();
+        }
+    }
+    return -1;
+}
+
+/*Drops random stacks on a board for the given time and prints how many
+stacks and cascades were done per second.*/
+template <int W, int H, int C>
+static void measure(double seconds) {
+    std::mt19937 rng(W * 100 + H);
+    Board<W, H, C> board;
+    board.clear();
+    long long stacks = 0;
+    long long cascades = 0;
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    while (elapsed < seconds) {
+        for (int n = 0; n < 1024; ++n) {
+            int col = rng() % W;
+            uint8_t stack[3] = {(uint8_t) (rng() % C + 1), (uint8_t) (rng() % C + 1), (uint8_t) (rng() % C + 1)};
+            int row = board.land(col, stack);
+            cascades += board.resolve();
+            ++stacks;
+            if (board.overflowed(col, row) || row >= H) {
+                board.clear();
+            }
+        }
+        elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    printf("Board<%2d, %2d, %d>  %2d bit masks  %10.0f stacks per second  %10.0f cascades per second\n", W, H, C,
+           (int) (8 * sizeof(typename Board<W, H, C>::Mask)), stacks / elapsed, cascades / elapsed);
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+
+    const long STACKS = 200000;
+    long differ[4] = {compareWithEngine<3>(STACKS), compareWithEngine<4>(STACKS), compareWithEngine<5>(STACKS),
+                      compareWithEngine<6>(STACKS)};
+    bool same = true;
+    for (int c = 0; c < 4; ++c) {
+        if (differ[c] >= 0) {
+            printf("%d colours: Board and engine differ after %ld stacks\n", c + 3, differ[c]);
+            same = false;
+        }
+    }
+    if (same) {
+        printf("Board<6, 15, C> matches the engine over %ld stacks for 3 to 6 colours\n\n", STACKS);
+    }
+
+    measure<6, 15, 4>(seconds);
+    measure<6, 15, 6>(seconds);
+    measure<7, 15, 7>(seconds);
+    measure<8, 20, 6>(seconds);
+    measure<8, 20, 7>(seconds);
+    measure<10, 30, 6>(seconds);
+    measure<5, 8, 4>(seconds);
+    return same ? 0 : 1;
+}
@@ -0,0 +1,210 @@
+/*Measures how long inputs take to reach the screen (see latency.h) on
+the host, with simulated input and a simulated clock. Games are played
+with random inputs, as record does, through the same session, drawing
+code and latency timing as on the Arduino; the recording display in
+host/mock/ counts the bytes each frame sends, and a model of the loop
+and the SPI bus turns them into time:
+
+- an input happens at a random moment between two ticks and is acted on
+  before the next tick, as the main loop takes it off the input queue;
+- the tick runs every TICK_MS, late if the loop was still busy, and the
+  ticks that came due meanwhile run in a row (up to MAX_CATCH_UP) before
+  one frame shows them all;
+- the bytes of a frame go out at SPI_BYTE_US each and keep the loop
+  busy until they are out, as every burst and library call waits for
+  its bytes, and the marker that ends the frame is reached when the
+  bytes before it are out.
+Once in a while the player pauses for a second, which is timed until
+"PAUSED" is on the screen.
+
+It prints the p50, p99 and slowest time from an input to the end of the
+frame that shows it, for every kind of input, rounded up to the next
+millisecond like the Arduino reports them, and the same from the tick
+that takes each step of a cascade, as planLanding() plans them (see
+host/planwatch.h; a step shown otherwise than planned fails the run).
+Last it prints how much game time was lost to ticks dropped when the
+loop fell more than MAX_CATCH_UP ticks behind.
+
+Usage: latbench [games per difficulty]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <Adafruit_ST7735.h>
+
+#include "display.h"
+#include "playfield.h"
+#include "blit.h"
+#include "spiqueue.h"
+#include "render.h"
+#include "latency.h"
+#include "host/mock/panel.h"
+#include "host/planwatch.h"
+
+#define MAX_TICKS (12L * LEVEL_TICKS) // games that last longer are stopped after 12 minutes
+#define PAUSE_US 1000000L // how long a pause lasts
+
+Adafruit_ST7735 tft = Adafruit_ST7735(TFT_CS, TFT_DC, TFT_RST);
+
+static const char* kindNames[NUM_LATENCY_KINDS] = {"move", "drop", "rotate", "pause"};
+
+// the simulated clock, in us
+static uint64_t sendFrom; // when the bus starts on the bytes of the current frame
+static long frameStart; // panelStats.bytes when the current frame started
+
+static PlanWatch watch;
+static std::vector<uint64_t> stepTimes; // from the tick of a cascade step to its frame being out
+static uint64_t playedUs; // game time played
+static uint64_t droppedUs; // game time lost to ticks dropped after MAX_CATCH_UP
+
+/*The marker hook: the bytes sent since the frame started are out.*/
+static void markerReached(uint8_t kinds) {
+    latencyShown(kinds, sendFrom + (panelStats.bytes - frameStart) * SPI_BYTE_US);
+}
+
+/*Starts a frame drawn at time now.*/
+static void beginFrame(uint64_t now) {
+    sendFrom = now;
+    frameStart = panelStats.bytes;
+}
+
+/*Returns when the loop is free again: once the frame's bytes are out.*/
+static uint64_t endFrame() {
+    return sendFrom + (uint64_t) ((panelStats.bytes - frameStart) * SPI_BYTE_US);
+}
+
+/*Plays and draws one game with random inputs, timing them as it goes.*/
+static void playGame(int difficulty, uint32_t seed) {
+    tft.initR(INITR_BLACKTAB);
+    blitInit();
+    displaySetMarkerHook(markerReached);
+    std::mt19937 player(seed);
+
+    Session session;
+    resetSession(&session, difficulty, seed);
+    drawGameScreen(&session);
+    resetPlayfield();
+    startDrawing(&session);
+
+    uint64_t cpuFree = 0; // when the loop is free to take input and run tasks
+    uint64_t nextTick = TICK_US; // the inputs before it happen from time 0
+    long bannerTicks = 0;
+    while (session.phase != Over && (long) session.tick < MAX_TICKS) {
+        if (session.phase == Falling && player() % 2000 == 0) {
+            uint64_t time = nextTick - TICK_US + player() % TICK_US;
+            uint64_t now = time > cpuFree ? time : cpuFree;
+            beginFrame(now);
+            drawPaused(true);
+            latencyInput(LatencyPause, time);
+            latencyFrame();
+            now = endFrame() + PAUSE_US;
+            beginFrame(now);
+            drawPaused(false);
+            cpuFree = endFrame();
+            nextTick = cpuFree; // the tick starts again once the game carries on
+        }
+
+        uint64_t now = nextTick > cpuFree ? nextTick : cpuFree;
+        int ticks = 0;
+        bool step = false;
+        bool hud = false;
+        do {
+            uint64_t last = nextTick - TICK_US;
+            if (player() % 16 == 0) { // as record plays
+                int input = player() % 3;
+                int value = 1;
+                if (input == MoveInput) {
+                    value = (int) (player() % 3) - 1;
+                }
+                else if (input == DropInput) {
+                    value = player() % 4 == 0;
+                }
+                uint64_t time = last + player() % TICK_US;
+                sessionInput(&session, input, value);
+                if (input == RotateInput || value > 0 || (input == MoveInput && value != 0)) {
+                    latencyInput(input, time);
+                }
+            }
+            // the watch looks at what this tick alone changed
+            uint16_t changed[NUM_COLS];
+            memcpy(changed, session.ChangedMask, sizeof(changed));
+            memset(session.ChangedMask, 0, sizeof(session.ChangedMask));
+            watchBefore(&watch, &session);
+            sessionTick(&session);
+            step |= watchAfter(&watch, &session) != 0;
+            for (int i = 0; i < NUM_COLS; ++i) {
+                session.ChangedMask[i] |= changed[i];
+            }
+            hud |= session.tick % (HUD_PERIOD / TICK_MS) == 0;
+            nextTick += TICK_US;
+            ++ticks;
+        } while (session.phase != Over && ticks < MAX_CATCH_UP && nextTick <= now);
+        if (nextTick <= now) {
+            droppedUs += now - nextTick;
+            nextTick = now; // the ticks past MAX_CATCH_UP are dropped
+        }
+
+        beginFrame(now);
+        if (drawSession(&session)) {
+            drawLevelBanner(true);
+            bannerTicks = BANNER_DELAY / TICK_MS;
+        }
+        else if (bannerTicks > 0 && (bannerTicks -= ticks) <= 0) {
+            bannerTicks = 0;
+            drawLevelBanner(false);
+        }
+        latencyFrame();
+        if (hud) {
+            refreshHud(&session);
+        }
+        cpuFree = endFrame();
+        if (step) {
+            stepTimes.push_back(cpuFree - now);
+        }
+    }
+    playedUs += (uint64_t) session.tick * TICK_US;
+    displaySetMarkerHook(0);
+}
+
+int main(int argc, char** argv) {
+    int games = argc > 1 ? atoi(argv[1]) : 25;
+    if (games < 1) {
+        fprintf(stderr, "usage: latbench [games per difficulty]\n");
+        return 2;
+    }
+    latencyReset();
+    resetWatch(&watch);
+    for (int difficulty = 3; difficulty <= 6; ++difficulty) {
+        for (int n = 0; n < games; ++n) {
+            playGame(difficulty, 1000 * difficulty + n + 1);
+        }
+    }
+
+    printf("%d games, from the input to the end of the frame that shows it, at %.0f us a byte\n\n",
+           4 * games, SPI_BYTE_US);
+    printf("%-8s %8s %8s %8s %8s\n", "input", "count", "p50 ms", "p99 ms", "max ms");
+    for (int k = 0; k < NUM_LATENCY_KINDS; ++k) {
+        const LatencyStats* stats = &latencyStats[k];
+        if (stats->count == 0) {
+            printf("%-8s %8d\n", kindNames[k], 0);
+            continue;
+        }
+        printf("%-8s %8u %8.1f %8.1f %8.1f\n", kindNames[k], stats->count, latencyPercentile(k, 50) / 1000.0,
+               latencyPercentile(k, 99) / 1000.0, stats->max / 1000.0);
+    }
+    if (!stepTimes.empty()) {
+        std::sort(stepTimes.begin(), stepTimes.end());
+        printf("%-8s %8zu %8.1f %8.1f %8.1f\n", "step", stepTimes.size(), stepTimes[stepTimes.size() / 2] / 1000.0,
+               stepTimes[(stepTimes.size() - 1) * 99 / 100] / 1000.0, stepTimes.back() / 1000.0);
+    }
+    printf("\n%.1f s of game time played, %.1f ms of it lost to dropped ticks\n", playedUs / 1e6, droppedUs / 1e3);
+    if (watch.mismatches > 0) {
+        printf("%ld steps or cascades went otherwise than planLanding() planned\n", watch.mismatches);
+        return 1;
+    }
+    return 0;
+}
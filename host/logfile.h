@@ -0,0 +1,41 @@
+/*Game logs in memory for the host tools: loading a log file, and the
+LogRead function that feeds one to a Replay (see gamelog.h).*/
+
+#ifndef HOST_LOGFILE_H
+#define HOST_LOGFILE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+struct LogBuffer {
+    std::vector<uint8_t> bytes;
+    size_t pos; // the next byte readLogBuffer returns
+};
+
+/*Reads a whole file into buffer. Returns false if it cannot be opened.*/
+inline bool loadLog(const char* path, LogBuffer* buffer) {
+    FILE* file = fopen(path, "rb");
+    if (file == 0) {
+        return false;
+    }
+    buffer->bytes.clear();
+    buffer->pos = 0;
+    uint8_t chunk[4096];
+    size_t count;
+    while ((count = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        buffer->bytes.insert(buffer->bytes.end(), chunk, chunk + count);
+    }
+    fclose(file);
+    return true;
+}
+
+inline int readLogBuffer(void* context) {
+    LogBuffer* buffer = (LogBuffer*) context;
+    if (buffer->pos >= buffer->bytes.size()) {
+        return -1;
+    }
+    return buffer->bytes[buffer->pos++];
+}
+
+#endif
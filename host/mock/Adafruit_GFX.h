@@ -0,0 +1,41 @@
+/*The part of Adafruit_GFX the game uses, drawn the way the library draws
+it: text with the built-in 5x7 font, pixel by pixel at size 1 and square
+by square above that, and everything else through the address windows
+and pixel writes of the display below (see panel.h).*/
+
+#ifndef MOCK_ADAFRUIT_GFX_H
+#define MOCK_ADAFRUIT_GFX_H
+
+#include <Arduino.h>
+
+class Adafruit_GFX : public Print {
+public:
+    Adafruit_GFX(int16_t w, int16_t h);
+
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t colour) = 0;
+    virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t colour) = 0;
+    virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t colour) = 0;
+    virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t colour) = 0;
+    void fillScreen(uint16_t colour);
+    void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t colour);
+    void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t colour, uint16_t bg, uint8_t size);
+
+    void setCursor(int16_t x, int16_t y) { cursorX = x; cursorY = y; }
+    void setTextColor(uint16_t colour) { textColour = colour; textBackground = colour; }
+    void setTextColor(uint16_t colour, uint16_t bg) { textColour = colour; textBackground = bg; }
+    void setTextSize(uint8_t size) { textSize = size > 0 ? size : 1; }
+    void setTextWrap(bool wrap) { this->wrap = wrap; }
+    int16_t width() const { return screenWidth; }
+    int16_t height() const { return screenHeight; }
+
+    virtual size_t write(uint8_t c);
+
+protected:
+    int16_t screenWidth, screenHeight;
+    int16_t cursorX, cursorY;
+    uint16_t textColour, textBackground; // the same colour for a transparent background
+    uint8_t textSize;
+    bool wrap;
+};
+
+#endif
@@ -0,0 +1,28 @@
+/*A stand-in for the Adafruit ST7735 driver that draws into the recording
+display of panel.h instead of a real screen. Every primitive sends the
+bytes the real driver would: an address window (CASET, RASET, RAMWR and
+their 8 data bytes), then two bytes per pixel.*/
+
+#ifndef MOCK_ADAFRUIT_ST7735_H
+#define MOCK_ADAFRUIT_ST7735_H
+
+#include <Adafruit_GFX.h>
+
+#define INITR_BLACKTAB 0x02
+
+class Adafruit_ST7735 : public Adafruit_GFX {
+public:
+    Adafruit_ST7735(int8_t cs, int8_t dc, int8_t rst);
+
+    void initR(uint8_t options);
+    virtual void drawPixel(int16_t x, int16_t y, uint16_t colour);
+    virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t colour);
+    virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t colour);
+    virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t colour);
+
+private:
+    void setAddrWindow(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+    void pushColour(uint16_t colour, long count);
+};
+
+#endif
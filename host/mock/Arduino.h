@@ -0,0 +1,48 @@
+/*Just enough of the Arduino core for the drawing code (render.cpp,
+playfield.cpp, blit.cpp) to compile on the host against the recording
+display in this directory, and for savegame.cpp and scheduler.cpp
+against the SD card model. Flash is ordinary memory here, so F() and
+PROGMEM do nothing. millis() is left to the tool that needs it, which
+keeps its own clock.*/
+
+#ifndef MOCK_ARDUINO_H
+#define MOCK_ARDUINO_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROGMEM
+#define pgm_read_word(address) (*(const uint16_t*) (address))
+#define pgm_read_byte(address) (*(const uint8_t*) (address))
+
+class __FlashStringHelper;
+#define F(text) (reinterpret_cast<const __FlashStringHelper*>(text))
+
+#define constrain(x, low, high) ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+
+unsigned long millis();
+
+/*The text output of the Arduino core: everything printed ends up as
+single characters passed to write().*/
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+
+    size_t print(const char* text);
+    size_t print(const __FlashStringHelper* text) { return print(reinterpret_cast<const char*>(text)); }
+    size_t print(char c) { return write(c); }
+    size_t print(int n) { return print((long) n); }
+    size_t print(unsigned int n) { return print((unsigned long) n); }
+    size_t print(long n);
+    size_t print(unsigned long n);
+
+    size_t println() { return print("\r\n"); }
+    template <typename T> size_t println(T value) {
+        size_t n = print(value);
+        return n + println();
+    }
+};
+
+#endif
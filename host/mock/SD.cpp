@@ -0,0 +1,75 @@
+#include "SD.h"
+
+#include <string.h>
+
+SDClass SD;
+
+/*Opens a file. A missing file is only created with O_CREAT, and goes on
+the card empty straight away, as does a file opened with O_TRUNC.*/
+File SDClass::open(const char* name, uint8_t mode) {
+    File file;
+    std::map<std::string, std::vector<uint8_t> >::iterator found = files.find(name);
+    if (found == files.end() && !(mode & O_CREAT)) {
+        return file;
+    }
+    file.open = true;
+    file.name = name;
+    file.mode = mode;
+    file.position = 0;
+    if (found != files.end() && !(mode & O_TRUNC)) {
+        file.contents = found->second;
+    }
+    else {
+        files[name].clear();
+    }
+    return file;
+}
+
+bool SDClass::remove(const char* name) {
+    return files.erase(name) > 0;
+}
+
+int File::read(void* buffer, uint16_t count) {
+    if (!open || !(mode & O_READ)) {
+        return -1;
+    }
+    if (position >= contents.size()) {
+        return 0;
+    }
+    if (count > contents.size() - position) {
+        count = contents.size() - position;
+    }
+    memcpy(buffer, &contents[position], count);
+    position += count;
+    return count;
+}
+
+size_t File::write(const uint8_t* bytes, size_t count) {
+    if (!open || !(mode & O_WRITE)) {
+        return 0;
+    }
+    if (mode & O_APPEND) {
+        position = contents.size();
+    }
+    if (position + count > contents.size()) {
+        contents.resize(position + count);
+    }
+    memcpy(&contents[position], bytes, count);
+    position += count;
+    return count;
+}
+
+bool File::seek(uint32_t to) {
+    if (!open || to > contents.size()) {
+        return false;
+    }
+    position = to;
+    return true;
+}
+
+void File::close() {
+    if (open && (mode & O_WRITE)) {
+        SD.files[name] = contents;
+    }
+    open = false;
+}
@@ -0,0 +1,58 @@
+/*Just enough of the Arduino SD library for savegame.cpp to run on the
+host, with the card kept in memory. The open flags mean what they do in
+the library: FILE_WRITE includes O_APPEND, which sends every write to
+the end of the file wherever seek() put it, and O_TRUNC empties the file
+on the card as it is opened. What is written only reaches the card when
+the file is closed, so a tool can copy SD.files half way through a write
+to see what a card whose power was cut would hold.*/
+
+#ifndef MOCK_SD_H
+#define MOCK_SD_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#define O_READ 0x01
+#define O_WRITE 0x02
+#define O_APPEND 0x04
+#define O_CREAT 0x10
+#define O_TRUNC 0x40
+
+#define FILE_READ O_READ
+#define FILE_WRITE (O_READ | O_WRITE | O_CREAT | O_APPEND)
+
+class File {
+public:
+    File() : open(false) {}
+
+    operator bool() const { return open; }
+    int read(void* buffer, uint16_t count);
+    size_t write(const uint8_t* bytes, size_t count);
+    bool seek(uint32_t position);
+    void close();
+
+private:
+    friend class SDClass;
+    bool open;
+    std::string name;
+    uint8_t mode;
+    uint32_t position;
+    std::vector<uint8_t> contents; // what the card will hold once the file is closed
+};
+
+class SDClass {
+public:
+    bool begin(uint8_t csPin = 0) { (void) csPin; return true; }
+    File open(const char* name, uint8_t mode = FILE_READ);
+    bool remove(const char* name);
+    bool exists(const char* name) { return files.count(name) != 0; }
+
+    std::map<std::string, std::vector<uint8_t> > files; // the card, for the tools to look at and damage
+};
+
+extern SDClass SD;
+
+#endif
@@ -0,0 +1,373 @@
+#include "panel.h"
+
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_ST7735.h>
+
+#include "spiqueue.h"
+
+PanelStats panelStats;
+FILE* panelTrace = 0;
+
+static uint16_t frame[PANEL_HEIGHT][PANEL_WIDTH];
+
+// the controller: the last command, its data bytes so far and the window
+static uint8_t command;
+static uint8_t args[4];
+static int argCount;
+static int x0, y0, x1, y1;
+static int x, y; // the next pixel written
+static int highByte = -1; // the first byte of a pixel, or -1
+
+// who is sending, only the outermost call counts
+static int source = FromBurst;
+static int depth = 0;
+
+static const char* sourceNames[PANEL_SOURCES] = {
+    "fillScreen", "fillRect", "drawFastHLine", "drawFastVLine", "drawRect", "drawPixel", "text", "burst"
+};
+
+/*Clears the screen to black and all the counters to zero.*/
+void panelReset() {
+    memset(frame, 0, sizeof(frame));
+    memset(&panelStats, 0, sizeof(panelStats));
+    command = 0;
+    argCount = 0;
+    highByte = -1;
+}
+
+/*The name of a PanelSource.*/
+const char* panelSourceName(int source) {
+    return sourceNames[source];
+}
+
+/*Receives one byte over SPI, a command (DC low) or data (DC high).*/
+void panelByte(uint8_t byte, bool data) {
+    ++panelStats.bytes;
+    ++panelStats.from[source].bytes;
+    if (!data) {
+        command = byte;
+        argCount = 0;
+        if (command == ST7735_RAMWR) {
+            ++panelStats.windows;
+            ++panelStats.from[source].windows;
+            x = x0;
+            y = y0;
+            highByte = -1;
+        }
+        return;
+    }
+    if (command == ST7735_CASET || command == ST7735_RASET) {
+        if (argCount < 4) {
+            args[argCount++] = byte;
+        }
+        if (argCount == 4) {
+            int start = (args[0] << 8) | args[1];
+            int end = (args[2] << 8) | args[3];
+            if (command == ST7735_CASET) {
+                x0 = start;
+                x1 = end;
+            }
+            else {
+                y0 = start;
+                y1 = end;
+            }
+        }
+    }
+    else if (command == ST7735_RAMWR) {
+        if (highByte < 0) {
+            highByte = byte;
+            return;
+        }
+        if (x < PANEL_WIDTH && y < PANEL_HEIGHT) {
+            frame[y][x] = (highByte << 8) | byte;
+        }
+        highByte = -1;
+        // the controller wraps around inside the window
+        if (++x > x1) {
+            x = x0;
+            if (++y > y1) {
+                y = y0;
+            }
+        }
+    }
+}
+
+/*The RGB565 colour the screen shows at (x, y).*/
+uint16_t panelPixel(int x, int y) {
+    return frame[y][x];
+}
+
+/*Saves the screen as a binary PPM image. Returns false if it can't be written.*/
+bool panelWritePPM(const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (file == 0) {
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", PANEL_WIDTH, PANEL_HEIGHT);
+    for (int y = 0; y < PANEL_HEIGHT; ++y) {
+        for (int x = 0; x < PANEL_WIDTH; ++x) {
+            uint16_t c = frame[y][x];
+            uint8_t rgb[3] = {(uint8_t) ((c >> 11) * 255 / 31), (uint8_t) (((c >> 5) & 0x3F) * 255 / 63),
+                              (uint8_t) ((c & 0x1F) * 255 / 31)};
+            fwrite(rgb, 1, 3, file);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+/*Counts a call of the library and puts the bytes sent until it returns
+down to it, unless it was made by another call.*/
+class PanelCall {
+public:
+    PanelCall(int from) : bytes(0) {
+        if (depth++ == 0) {
+            source = from;
+            bytes = panelStats.bytes;
+            ++panelStats.from[from].calls;
+        }
+    }
+    ~PanelCall() {
+        if (--depth == 0) {
+            source = FromBurst;
+        }
+    }
+    // writes the call to the trace, once it is done
+    void trace(const char* name, int a, int b, int c, int d) {
+        if (panelTrace != 0 && depth == 1) {
+            fprintf(panelTrace, "%s %d %d %d %d: %ld bytes\n", name, a, b, c, d, panelStats.bytes - bytes);
+        }
+    }
+
+private:
+    long bytes;
+};
+
+/*Adafruit's 5x7 font: one byte per column, lowest bit at the top. Only
+the characters the game shows are here; lower case is drawn as upper
+case and anything else as '?'.*/
+static const uint8_t font[][5] = {
+    {0x00, 0x00, 0x00, 0x00, 0x00}, // ' '
+    {0x00, 0x00, 0x5F, 0x00, 0x00}, // '!'
+    {0x00, 0x36, 0x36, 0x00, 0x00}, // ':'
+    {0x08, 0x08, 0x08, 0x08, 0x08}, // '-'
+    {0x02, 0x01, 0x51, 0x09, 0x06}, // '?'
+    {0x3E, 0x51, 0x49, 0x45, 0x3E}, {0x00, 0x42, 0x7F, 0x40, 0x00}, {0x72, 0x49, 0x49, 0x49, 0x46},
+    {0x21, 0x41, 0x49, 0x4D, 0x33}, {0x18, 0x14, 0x12, 0x7F, 0x10}, {0x27, 0x45, 0x45, 0x45, 0x39},
+    {0x3C, 0x4A, 0x49, 0x49, 0x31}, {0x41, 0x21, 0x11, 0x09, 0x07}, {0x36, 0x49, 0x49, 0x49, 0x36},
+    {0x46, 0x49, 0x49, 0x29, 0x1E}, // '0' to '9'
+    {0x7C, 0x12, 0x11, 0x12, 0x7C}, {0x7F, 0x49, 0x49, 0x49, 0x36}, {0x3E, 0x41, 0x41, 0x41, 0x22},
+    {0x7F, 0x41, 0x41, 0x41, 0x3E}, {0x7F, 0x49, 0x49, 0x49, 0x41}, {0x7F, 0x09, 0x09, 0x09, 0x01},
+    {0x3E, 0x41, 0x41, 0x51, 0x73}, {0x7F, 0x08, 0x08, 0x08, 0x7F}, {0x00, 0x41, 0x7F, 0x41, 0x00},
+    {0x20, 0x40, 0x41, 0x3F, 0x01}, {0x7F, 0x08, 0x14, 0x22, 0x41}, {0x7F, 0x40, 0x40, 0x40, 0x40},
+    {0x7F, 0x02, 0x1C, 0x02, 0x7F}, {0x7F, 0x04, 0x08, 0x10, 0x7F}, {0x3E, 0x41, 0x41, 0x41, 0x3E},
+    {0x7F, 0x09, 0x09, 0x09, 0x06}, {0x3E, 0x41, 0x51, 0x21, 0x5E}, {0x7F, 0x09, 0x19, 0x29, 0x46},
+    {0x26, 0x49, 0x49, 0x49, 0x32}, {0x03, 0x01, 0x7F, 0x01, 0x03}, {0x3F, 0x40, 0x40, 0x40, 0x3F},
+    {0x1F, 0x20, 0x40, 0x20, 0x1F}, {0x3F, 0x40, 0x38, 0x40, 0x3F}, {0x63, 0x14, 0x08, 0x14, 0x63},
+    {0x03, 0x04, 0x78, 0x04, 0x03}, {0x61, 0x59, 0x49, 0x4D, 0x43} // 'A' to 'Z'
+};
+
+/*The columns of character c in the font.*/
+static const uint8_t* glyph(unsigned char c) {
+    if (c >= 'a' && c <= 'z') {
+        c -= 'a' - 'A';
+    }
+    if (c >= '0' && c <= '9') {
+        return font[5 + c - '0'];
+    }
+    if (c >= 'A' && c <= 'Z') {
+        return font[15 + c - 'A'];
+    }
+    switch (c) {
+        case ' ': return font[0];
+        case '!': return font[1];
+        case ':': return font[2];
+        case '-': return font[3];
+        default: return font[4];
+    }
+}
+
+size_t Print::print(const char* text) {
+    size_t n = 0;
+    while (*text != 0) {
+        n += write(*text++);
+    }
+    return n;
+}
+
+size_t Print::print(long n) {
+    char digits[12];
+    snprintf(digits, sizeof(digits), "%ld", n);
+    return print(digits);
+}
+
+size_t Print::print(unsigned long n) {
+    char digits[12];
+    snprintf(digits, sizeof(digits), "%lu", n);
+    return print(digits);
+}
+
+Adafruit_GFX::Adafruit_GFX(int16_t w, int16_t h)
+    : screenWidth(w), screenHeight(h), cursorX(0), cursorY(0),
+      textColour(0xFFFF), textBackground(0xFFFF), textSize(1), wrap(true) {
+}
+
+void Adafruit_GFX::fillScreen(uint16_t colour) {
+    PanelCall call(FromFillScreen);
+    fillRect(0, 0, screenWidth, screenHeight, colour);
+    call.trace("fillScreen", colour, 0, 0, 0);
+}
+
+void Adafruit_GFX::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t colour) {
+    PanelCall call(FromRect);
+    drawFastHLine(x, y, w, colour);
+    drawFastHLine(x, y + h - 1, w, colour);
+    drawFastVLine(x, y, h, colour);
+    drawFastVLine(x + w - 1, y, h, colour);
+    call.trace("drawRect", x, y, w, h);
+}
+
+/*As the library does it: every pixel of the 6x8 cell that is lit is a
+drawPixel (or a size x size fillRect), and so is every pixel of the
+background unless it is transparent.*/
+void Adafruit_GFX::drawChar(int16_t x, int16_t y, unsigned char c, uint16_t colour, uint16_t bg, uint8_t size) {
+    if (x >= screenWidth || y >= screenHeight || x + 6*size - 1 < 0 || y + 8*size - 1 < 0) {
+        return;
+    }
+    PanelCall call(FromText);
+    const uint8_t* columns = glyph(c);
+    for (int i = 0; i < 6; ++i) {
+        uint8_t line = i < 5 ? columns[i] : 0;
+        for (int j = 0; j < 8; ++j, line >>= 1) {
+            if (!(line & 1) && bg == colour) {
+                continue;
+            }
+            uint16_t pixel = line & 1 ? colour : bg;
+            if (size == 1) {
+                drawPixel(x + i, y + j, pixel);
+            }
+            else {
+                fillRect(x + i*size, y + j*size, size, size, pixel);
+            }
+        }
+    }
+    if (panelTrace != 0 && depth == 1) {
+        fprintf(panelTrace, "'%c' ", c);
+    }
+    call.trace("drawChar", x, y, size, 0);
+}
+
+size_t Adafruit_GFX::write(uint8_t c) {
+    if (c == '\n') {
+        cursorY += textSize * 8;
+        cursorX = 0;
+    }
+    else if (c != '\r') {
+        if (wrap && cursorX + textSize*6 > screenWidth) {
+            cursorX = 0;
+            cursorY += textSize * 8;
+        }
+        drawChar(cursorX, cursorY, c, textColour, textBackground, textSize);
+        cursorX += textSize * 6;
+    }
+    return 1;
+}
+
+Adafruit_ST7735::Adafruit_ST7735(int8_t cs, int8_t dc, int8_t rst) : Adafruit_GFX(PANEL_WIDTH, PANEL_HEIGHT) {
+}
+
+void Adafruit_ST7735::initR(uint8_t options) {
+    panelReset();
+}
+
+/*CASET, RASET and RAMWR with their coordinates as 16 bit numbers.*/
+void Adafruit_ST7735::setAddrWindow(int16_t x0, int16_t y0, int16_t x1, int16_t y1) {
+    panelByte(ST7735_CASET, false);
+    panelByte(0, true);
+    panelByte(x0, true);
+    panelByte(0, true);
+    panelByte(x1, true);
+    panelByte(ST7735_RASET, false);
+    panelByte(0, true);
+    panelByte(y0, true);
+    panelByte(0, true);
+    panelByte(y1, true);
+    panelByte(ST7735_RAMWR, false);
+}
+
+void Adafruit_ST7735::pushColour(uint16_t colour, long count) {
+    for (long i = 0; i < count; ++i) {
+        panelByte(colour >> 8, true);
+        panelByte(colour, true);
+    }
+}
+
+void Adafruit_ST7735::drawPixel(int16_t x, int16_t y, uint16_t colour) {
+    if (x < 0 || x >= screenWidth || y < 0 || y >= screenHeight) {
+        return;
+    }
+    PanelCall call(FromPixel);
+    setAddrWindow(x, y, x + 1, y + 1);
+    pushColour(colour, 1);
+    call.trace("drawPixel", x, y, colour, 0);
+}
+
+void Adafruit_ST7735::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t colour) {
+    if (x >= screenWidth || y >= screenHeight) {
+        return;
+    }
+    if (y + h - 1 >= screenHeight) {
+        h = screenHeight - y;
+    }
+    PanelCall call(FromVLine);
+    setAddrWindow(x, y, x, y + h - 1);
+    pushColour(colour, h);
+    call.trace("drawFastVLine", x, y, h, colour);
+}
+
+void Adafruit_ST7735::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t colour) {
+    if (x >= screenWidth || y >= screenHeight) {
+        return;
+    }
+    if (x + w - 1 >= screenWidth) {
+        w = screenWidth - x;
+    }
+    PanelCall call(FromHLine);
+    setAddrWindow(x, y, x + w - 1, y);
+    pushColour(colour, w);
+    call.trace("drawFastHLine", x, y, w, colour);
+}
+
+/*Clipped to the screen the way the library clips it.*/
+void Adafruit_ST7735::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t colour) {
+    if (x >= screenWidth || y >= screenHeight) {
+        return;
+    }
+    if (x + w - 1 >= screenWidth) {
+        w = screenWidth - x;
+    }
+    if (y + h - 1 >= screenHeight) {
+        h = screenHeight - y;
+    }
+    PanelCall call(FromFillRect);
+    setAddrWindow(x, y, x + w - 1, y + h - 1);
+    pushColour(colour, (long) w * h);
+    call.trace("fillRect", x, y, w, h);
+}
+
+/*The Arduino's displaySend(): the bytes of the command just given go
+straight to the screen.*/
+void displaySend() {
+    long bytes = panelStats.bytes;
+    uint8_t byte;
+    bool data;
+    while (displayNextByte(&byte, &data)) {
+        panelByte(byte, data);
+    }
+    if (panelStats.bytes > bytes) {
+        ++panelStats.from[FromBurst].calls;
+        if (panelTrace != 0) {
+            fprintf(panelTrace, "burst: %ld bytes\n", panelStats.bytes - bytes);
+        }
+    }
+}
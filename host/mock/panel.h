@@ -0,0 +1,48 @@
+/*The recording display behind the mock Adafruit_ST7735 and the host's
+displaySend(). It models the ST7735 controller at the level of the SPI
+bytes it receives: a CASET and a RASET command set the address window,
+RAMWR starts writing it, and every two data bytes after that are one
+RGB565 pixel, filled left to right and top to bottom. So the picture it
+ends up with is what the real screen would show, and its counters are
+what the real bus would carry.
+
+Every byte is put down to whatever sent it: one of the library's
+primitives (counted once per call the game makes, not for the calls
+they make themselves) or the bursts of spiqueue.h that blit.cpp and
+playfield.cpp send.*/
+
+#ifndef MOCK_PANEL_H
+#define MOCK_PANEL_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define PANEL_WIDTH 128
+#define PANEL_HEIGHT 160
+#define SPI_BYTE_US 2.0 // one byte at 4 MHz, the clock the Adafruit library sets
+
+enum PanelSource {FromFillScreen, FromFillRect, FromHLine, FromVLine, FromRect, FromPixel, FromText, FromBurst,
+                  PANEL_SOURCES};
+
+struct PanelCount {
+    long calls;
+    long windows; // address windows opened
+    long bytes; // commands and data
+};
+
+struct PanelStats {
+    PanelCount from[PANEL_SOURCES];
+    long windows;
+    long bytes;
+};
+
+extern PanelStats panelStats;
+extern FILE* panelTrace; // when set, every call is written here with the bytes it sent
+
+void panelReset();
+void panelByte(uint8_t byte, bool data);
+uint16_t panelPixel(int x, int y);
+bool panelWritePPM(const char* path);
+const char* panelSourceName(int source);
+
+#endif
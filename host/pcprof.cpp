@@ -0,0 +1,272 @@
+/*Turns the histogram an Arduino built with "make upload SAMPLE=1" dumps
+over the serial port (see sampler.h) into a flat profile: the functions
+of the program with the share of the samples that landed in them, the
+busiest first. It takes the last good dump in a capture of the port,
+skipping the text printed around it, and the functions from the ELF file
+of the same build, through avr-nm. A bin that straddles two functions is
+shared between them by how many of its bytes each covers, so small
+functions next to a busy one can be given a little of its time.
+
+Capture the port while sending it 'D' (or wait for game over), for example:
+  stty -F /dev/ttyACM0 500000 raw -echo; cat /dev/ttyACM0 > game.samples
+"-s" reads the functions from a listing saved with "avr-nm -n -S -C"
+instead, and "-a" lists every function that was sampled, not only the
+first 30.
+
+Usage: pcprof [-a] (-e program.elf | -s symbols.txt) [capture]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "sampler.h"
+
+#define SHOWN 30 // the functions listed without -a
+
+struct Symbol {
+    uint32_t start, end; // the bytes of flash it takes
+    std::string name;
+    double samples;
+};
+
+struct Dump {
+    int shift;
+    uint32_t samples;
+    std::vector<uint16_t> counts;
+};
+
+static uint32_t readLittle(const uint8_t* bytes, int count) {
+    uint32_t value = 0;
+    for (int i = count - 1; i >= 0; --i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+/*Decodes the dump starting at offset in bytes. Returns its size, or 0 if
+there is no whole, correct dump there.*/
+static size_t decodeDump(const std::vector<uint8_t>& bytes, size_t offset, Dump* dump) {
+    const uint8_t* p = &bytes[offset];
+    size_t left = bytes.size() - offset;
+    if (left < SAMPLE_HEADER_SIZE || p[0] != 'M' || p[1] != 'C' || p[2] != 'S' || p[3] != SAMPLE_VERSION) {
+        return 0;
+    }
+    uint32_t bins = readLittle(p + 5, 2);
+    size_t size = SAMPLE_HEADER_SIZE + 2 * bins + 2;
+    if (bins == 0 || bins > SAMPLE_BINS || left < size) {
+        return 0;
+    }
+    uint16_t a = 0, b = 0;
+    for (size_t i = 4; i < size - 2; ++i) {
+        a = (a + p[i]) % 255;
+        b = (b + a) % 255;
+    }
+    if (readLittle(p + size - 2, 2) != (uint32_t) ((b << 8) | a)) {
+        return 0;
+    }
+    dump->shift = p[4];
+    dump->samples = readLittle(p + 7, 4);
+    dump->counts.resize(bins);
+    for (uint32_t bin = 0; bin < bins; ++bin) {
+        dump->counts[bin] = readLittle(p + SAMPLE_HEADER_SIZE + 2 * bin, 2);
+    }
+    return size;
+}
+
+/*Reads the code symbols of an "nm -n -S -C" listing, in address order.
+A symbol without a size runs up to the next one.*/
+static bool readSymbols(FILE* listing, std::vector<Symbol>* symbols) {
+    char line[1024];
+    while (fgets(line, sizeof(line), listing) != 0) {
+        line[strcspn(line, "\r\n")] = 0;
+        char* rest;
+        unsigned long address = strtoul(line, &rest, 16);
+        if (rest == line || *rest != ' ') {
+            continue; // an undefined symbol or a file name
+        }
+        ++rest;
+        unsigned long size = 0;
+        char* type = rest;
+        if (rest[0] != 0 && rest[1] != ' ') { // a size comes first
+            size = strtoul(rest, &type, 16);
+            if (*type++ != ' ') {
+                continue;
+            }
+        }
+        if (strchr("tTwW", type[0]) == 0 || type[1] != ' ') {
+            continue; // not code
+        }
+        Symbol symbol;
+        symbol.start = address;
+        symbol.end = address + size;
+        symbol.name = type + 2;
+        symbol.samples = 0;
+        symbols->push_back(symbol);
+    }
+    std::stable_sort(symbols->begin(), symbols->end(),
+                     [](const Symbol& a, const Symbol& b) { return a.start < b.start; });
+    // of the names for one address (aliases, labels), keep the first with a size
+    std::vector<Symbol> kept;
+    for (size_t i = 0; i < symbols->size(); ++i) {
+        const Symbol& symbol = (*symbols)[i];
+        if (!kept.empty() && kept.back().start == symbol.start) {
+            if (kept.back().end == kept.back().start) {
+                kept.back() = symbol;
+            }
+            continue;
+        }
+        kept.push_back(symbol);
+    }
+    symbols->swap(kept);
+    for (size_t i = 0; i < symbols->size(); ++i) {
+        Symbol* symbol = &(*symbols)[i];
+        if (symbol->end == symbol->start) {
+            symbol->end = i + 1 < symbols->size() ? (*symbols)[i+1].start : symbol->start;
+        }
+    }
+    return !symbols->empty();
+}
+
+int main(int argc, char** argv) {
+    bool all = false;
+    const char* elfPath = 0;
+    const char* symbolsPath = 0;
+    const char* path = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-a") == 0) {
+            all = true;
+        }
+        else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+            elfPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            symbolsPath = argv[++i];
+        }
+        else if (argv[i][0] != '-' && path == 0) {
+            path = argv[i];
+        }
+        else {
+            elfPath = symbolsPath = 0;
+            break;
+        }
+    }
+    if ((elfPath == 0) == (symbolsPath == 0)) {
+        fprintf(stderr, "usage: pcprof [-a] (-e program.elf | -s symbols.txt) [capture]\n");
+        return 2;
+    }
+
+    FILE* listing;
+    if (elfPath != 0) {
+        std::string command = "avr-nm -n -S -C '" + std::string(elfPath) + "'";
+        listing = popen(command.c_str(), "r");
+    }
+    else {
+        listing = fopen(symbolsPath, "r");
+    }
+    if (listing == 0) {
+        perror(elfPath != 0 ? "avr-nm" : symbolsPath);
+        return 1;
+    }
+    std::vector<Symbol> symbols;
+    bool found = readSymbols(listing, &symbols);
+    if (elfPath != 0) {
+        pclose(listing);
+    }
+    else {
+        fclose(listing);
+    }
+    if (!found) {
+        fprintf(stderr, "no functions found in %s\n", elfPath != 0 ? elfPath : symbolsPath);
+        return 1;
+    }
+
+    FILE* file = path != 0 ? fopen(path, "rb") : stdin;
+    if (file == 0) {
+        perror(path);
+        return 1;
+    }
+    std::vector<uint8_t> bytes;
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + count);
+    }
+
+    // every dump holds all the samples since the last clear, so the last one is enough
+    Dump dump = Dump();
+    int dumps = 0;
+    for (size_t i = 0; i < bytes.size(); ) {
+        Dump next;
+        size_t size = decodeDump(bytes, i, &next);
+        if (size > 0) {
+            dump = next;
+            ++dumps;
+            i += size;
+        }
+        else {
+            ++i;
+        }
+    }
+    if (dumps == 0) {
+        fprintf(stderr, "no sample dumps found\n");
+        return 1;
+    }
+
+    // share every bin out among the functions it overlaps
+    double unknown = 0;
+    uint32_t binned = 0;
+    uint32_t width = 1UL << dump.shift;
+    size_t first = 0; // the first function that does not end before the bin
+    for (size_t bin = 0; bin < dump.counts.size(); ++bin) {
+        uint32_t count = dump.counts[bin];
+        if (count == 0) {
+            continue;
+        }
+        binned += count;
+        uint32_t low = bin * width, high = low + width;
+        while (first < symbols.size() && symbols[first].end <= low) {
+            ++first;
+        }
+        uint32_t covered = 0;
+        for (size_t s = first; s < symbols.size() && symbols[s].start < high; ++s) {
+            uint32_t from = std::max(symbols[s].start, low), to = std::min(symbols[s].end, high);
+            if (to > from) {
+                symbols[s].samples += (double) count * (to - from) / width;
+                covered += to - from;
+            }
+        }
+        if (covered < width) {
+            unknown += (double) count * (width - std::min(covered, width)) / width;
+        }
+    }
+    Symbol outside;
+    outside.name = "(no function)";
+    outside.samples = unknown + (dump.samples - binned); // past the bins, or between the functions
+    if (outside.samples > 0) {
+        symbols.push_back(outside);
+    }
+    std::stable_sort(symbols.begin(), symbols.end(),
+                     [](const Symbol& a, const Symbol& b) { return a.samples > b.samples; });
+
+    printf("%u samples (%.1f s at %d a second), %zu bins of %u bytes, from the last of %d dumps\n\n",
+           dump.samples, dump.samples * (SAMPLE_TIMER_TOP + 1) * 8.0 / 16e6, 16000000 / 8 / (SAMPLE_TIMER_TOP + 1),
+           dump.counts.size(), width, dumps);
+    if (dump.samples == 0) {
+        return 0;
+    }
+    printf("%7s %7s %10s  %s\n", "%", "cumul %", "samples", "function");
+    double cumulative = 0;
+    for (size_t s = 0; s < symbols.size() && symbols[s].samples > 0; ++s) {
+        if (!all && s == SHOWN) {
+            printf("... and more, -a lists them all\n");
+            break;
+        }
+        double share = 100.0 * symbols[s].samples / dump.samples;
+        cumulative += share;
+        printf("%7.2f %7.2f %10.1f  %s\n", share, cumulative, symbols[s].samples, symbols[s].name.c_str());
+    }
+    return 0;
+}
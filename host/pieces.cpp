@@ -0,0 +1,32 @@
+/*Prints the stacks a game gets for a seed and difficulty, exactly as the
+Arduino picks them, one stack per line from the bottom block to the top.
+A game played with `make upload PIECE_SEED=<seed>` gets this sequence.
+
+Usage: pieces [seed] [difficulty] [count]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "engine.h"
+
+static const char* shadeNames[NUM_SHADES] = {"Black", "Green", "Blue", "Orange", "Magenta", "Yellow", "Cyan"};
+
+int main(int argc, char** argv) {
+    uint32_t seed = argc > 1 ? strtoul(argv[1], 0, 0) : DEFAULT_SEED;
+    int difficulty = argc > 2 ? atoi(argv[2]) : 4;
+    int count = argc > 3 ? atoi(argv[3]) : 20;
+    if (difficulty < 3 || difficulty > 6) {
+        fprintf(stderr, "difficulty must be between 3 and 6\n");
+        return 1;
+    }
+
+    Game game;
+    resetGame(&game, difficulty, seed);
+    // the Arduino picks the stack on screen and the preview of the next one at the start
+    for (int n = 0; n < count; ++n) {
+        Shade B, M, T;
+        randomStack(&game, &B, &M, &T);
+        printf("%s %s %s\n", shadeNames[B], shadeNames[M], shadeNames[T]);
+    }
+    return 0;
+}
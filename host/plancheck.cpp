@@ -0,0 +1,56 @@
+/*Plays games with random inputs, as record does, and checks every
+cascade the session shows against planLanding() (see host/planwatch.h):
+each step must clear and move the cells the plan says, for its points,
+and the cascade must end on the planned grid and score. Exits with 1 if
+any landing went otherwise than planned.
+
+Usage: plancheck [games]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+
+#include "host/planwatch.h"
+
+#define MAX_TICKS (12L * LEVEL_TICKS) // games that last longer are stopped after 12 minutes
+
+/*Plays game n, following it with watch.*/
+static void playGame(long n, int difficulty, PlanWatch* watch) {
+    std::mt19937 player(n);
+    Session session;
+    resetSession(&session, difficulty, n + 1);
+    while (session.phase != Over && (long) session.tick < MAX_TICKS) {
+        if (player() % 16 == 0) {
+            int input = player() % 3;
+            int value = 1;
+            if (input == MoveInput) {
+                value = (int) (player() % 3) - 1;
+            }
+            else if (input == DropInput) {
+                value = player() % 4 == 0;
+            }
+            sessionInput(&session, input, value);
+        }
+        watchBefore(watch, &session);
+        sessionTick(&session);
+        watchAfter(watch, &session);
+        memset(session.ChangedMask, 0, sizeof(session.ChangedMask)); // as the display would
+    }
+}
+
+int main(int argc, char** argv) {
+    long games = argc > 1 ? atol(argv[1]) : 3000;
+    if (games < 1) {
+        fprintf(stderr, "usage: plancheck [games]\n");
+        return 2;
+    }
+    PlanWatch watch;
+    resetWatch(&watch);
+    for (long n = 0; n < games; ++n) {
+        playGame(n, 3 + n % 4, &watch);
+    }
+    printf("%ld games, %ld landings, %ld cascade steps: %ld differ from planLanding\n", games, watch.landings,
+           watch.steps, watch.mismatches);
+    return watch.mismatches > 0 ? 1 : 0;
+}
@@ -0,0 +1,62 @@
+#include "host/planwatch.h"
+
+#include <string.h>
+
+void resetWatch(PlanWatch* watch) {
+    memset(watch, 0, sizeof(*watch));
+    watch->next = -1;
+}
+
+/*Remembers what the tick about to run starts from.*/
+void watchBefore(PlanWatch* watch, const Session* session) {
+    watch->before = session->game;
+    watch->phase = session->phase;
+    watch->wait = session->wait;
+}
+
+/*Checks the tick that just ran against the plan. Returns the step of the
+plan it showed, or 0 if it showed none (or not the planned one).*/
+const CascadeStep* watchAfter(PlanWatch* watch, const Session* session) {
+    if (watch->phase == Falling) {
+        if (session->phase != Falling) { // landed: plan what it sets off
+            Shade stack[3] = {session->Bcolour, session->Mcolour, session->Tcolour};
+            planLanding(&watch->before, session->col, stackRow(session->y), stack, &watch->plan);
+            watch->plannedScore = watch->before.score + watch->plan.points;
+            watch->next = 0;
+            ++watch->landings;
+        }
+        return 0;
+    }
+    if (watch->phase != Checking || watch->next < 0 || watch->wait > 0) {
+        return 0; // no step was taken in this tick
+    }
+
+    const CascadeStep* shown = 0;
+    bool changed = false;
+    for (int i = 0; i < NUM_COLS; ++i) {
+        changed |= session->ChangedMask[i] != 0;
+    }
+    if (changed) {
+        bool same = watch->next < watch->plan.steps;
+        const CascadeStep* step = &watch->plan.step[same ? watch->next : 0];
+        for (int i = 0; i < NUM_COLS && same; ++i) {
+            same = session->ChangedMask[i] == (step->cleared[i] | step->moved[i]);
+        }
+        if (same && session->game.score - watch->before.score == step->points) {
+            shown = step;
+        }
+        else {
+            ++watch->mismatches;
+        }
+        ++watch->next;
+        ++watch->steps;
+    }
+    if (session->phase != Checking) { // the cascade is over
+        if (watch->next != watch->plan.steps || session->game.score != watch->plannedScore ||
+                memcmp(session->game.ColourBits, watch->plan.ColourBits, sizeof(watch->plan.ColourBits)) != 0) {
+            ++watch->mismatches;
+        }
+        watch->next = -1;
+    }
+    return shown;
+}
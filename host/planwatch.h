@@ -0,0 +1,33 @@
+/*Follows a Session next to planLanding(): whenever a stack lands, the
+whole cascade it sets off is planned from the grid it landed on, and
+every step the session then shows is checked against the plan, as is the
+grid it ends up with. The session works its cascades out one
+cascadeStep() at a time, so the two must always agree; the tools that
+draw games use the plan to tell which ticks show a step of a cascade.
+
+Call watchBefore() before every sessionTick() and watchAfter() after it,
+while ChangedMask still holds what the tick changed.*/
+
+#ifndef HOST_PLANWATCH_H
+#define HOST_PLANWATCH_H
+
+#include "session.h"
+
+struct PlanWatch {
+    Game before; // the grid before the tick
+    uint8_t phase; // the phase before the tick
+    uint16_t wait; // and how long the session was still waiting
+    CascadePlan plan; // of the last landing
+    int32_t plannedScore; // the score once it is over
+    int next; // the step of the plan the session shows next, or -1 between cascades
+
+    long landings;
+    long steps;
+    long mismatches; // steps and cascades that went otherwise than planned
+};
+
+void resetWatch(PlanWatch* watch);
+void watchBefore(PlanWatch* watch, const Session* session);
+const CascadeStep* watchAfter(PlanWatch* watch, const Session* session);
+
+#endif
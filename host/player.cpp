@@ -0,0 +1,99 @@
+#include "host/player.h"
+
+#include <chrono>
+
+/*Sets up a player for a new game. seed only matters for RandomPolicy.*/
+void resetPlayer(Player* player, int policy, const AiSettings* settings, WorkPool* pool, int reactionTicks,
+                 uint64_t seed) {
+    player->policy = policy;
+    player->settings = *settings;
+    player->pool = pool;
+    player->log = 0;
+    player->reactionTicks = reactionTicks;
+    player->random.seed(seed);
+    player->decided = 0;
+    player->seen = 0;
+    player->target = ENTER_COL;
+    player->rotations = 0;
+    player->decisions = 0;
+    player->missed = 0;
+    player->thinking = 0;
+    player->nodes = 0;
+    player->probes = 0;
+    player->hits = 0;
+}
+
+/*Passes an input to the session and writes it to the log.*/
+static void press(Player* player, Session* session, uint8_t input, int8_t value) {
+    sessionInput(session, input, value);
+    if (player->log != 0) {
+        logInput(player->log, session->tick, input, value);
+    }
+}
+
+/*Works out where the stack that just came in should go.*/
+static void decide(Player* player, const Session* session) {
+    if (player->policy == RandomPolicy) {
+        player->target = player->random() % NUM_COLS;
+        player->rotations = player->random() % AI_ROTATIONS;
+        ++player->decisions;
+        return;
+    }
+    AiSettings settings = player->settings;
+    if (player->policy == GreedyPolicy) {
+        settings.depth = 1;
+    }
+    Shade current[3] = {session->Bcolour, session->Mcolour, session->Tcolour};
+    Shade next[3] = {session->nextBcolour, session->nextMcolour, session->nextTcolour};
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    AiChoice choice = choosePlacement(player->pool, &session->game, current, next, &settings);
+    player->thinking += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ++player->decisions;
+    player->nodes += choice.nodes;
+    player->probes += choice.probes;
+    player->hits += choice.hits;
+    player->target = choice.col;
+    player->rotations = choice.rotation;
+}
+
+/*Lets the player look at the session and move the controls.*/
+static void moveControls(Player* player, Session* session) {
+    if (session->phase != Falling) {
+        return;
+    }
+    if (session->stacks != player->decided) {
+        player->decided = session->stacks;
+        player->seen = session->tick;
+        if (session->dropping) {
+            press(player, session, DropInput, 0);
+        }
+        if (session->joyH != 0) {
+            press(player, session, MoveInput, 0);
+        }
+        decide(player, session);
+    }
+    if (session->tick - player->seen < (uint32_t) player->reactionTicks) {
+        return;
+    }
+    for (; player->rotations > 0; --player->rotations) {
+        press(player, session, RotateInput, 1);
+    }
+    int direction = player->target > session->col ? 1 : player->target < session->col ? -1 : 0;
+    if (direction != session->joyH) {
+        press(player, session, MoveInput, direction);
+    }
+    if (direction == 0 && !session->dropping) {
+        press(player, session, DropInput, 1);
+    }
+}
+
+/*Runs one tick of the session after letting the player move the controls,
+and counts the stack as missed if it lands away from the player's column.*/
+void playerTick(Player* player, Session* session) {
+    moveControls(player, session);
+    bool falling = session->phase == Falling;
+    sessionTick(session);
+    if (falling && session->phase != Falling && session->col != player->target) {
+        ++player->missed;
+    }
+}
@@ -0,0 +1,47 @@
+/*A simulated player for the host tools: it watches a Session, picks a
+column and rotation for every stack with one of several policies, and
+sends the inputs a person would to get it there: after its reaction time
+it presses the colour button, holds the joystick towards the column, and
+holds it down once the stack is above it. Every input can also be
+written to a game log.*/
+
+#ifndef HOST_PLAYER_H
+#define HOST_PLAYER_H
+
+#include <random>
+
+#include "gamelog.h"
+#include "host/ai.h"
+
+enum Policy {
+    RandomPolicy, // any column and rotation
+    GreedyPolicy, // the best placement of this stack alone (the AI at depth 1)
+    AiPolicy // the AI with the player's settings
+};
+
+struct Player {
+    int policy;
+    AiSettings settings; // for AiPolicy
+    WorkPool* pool; // for the AI's search, or 0 to search on the calling thread
+    LogWriter* log; // where the inputs go, or 0
+    int reactionTicks; // how long a new stack is watched before anything is pressed
+    std::mt19937_64 random; // for RandomPolicy
+
+    uint16_t decided; // the stack the plan is for
+    uint32_t seen; // the tick it came in
+    int target;
+    int rotations; // colour button presses still to make
+
+    long long decisions;
+    long long missed; // stacks that landed somewhere else than planned
+    double thinking; // seconds spent choosing
+    long long nodes;
+    long long probes;
+    long long hits;
+};
+
+void resetPlayer(Player* player, int policy, const AiSettings* settings, WorkPool* pool, int reactionTicks,
+                 uint64_t seed);
+void playerTick(Player* player, Session* session);
+
+#endif
@@ -0,0 +1,229 @@
+/*Decodes what an Arduino built with "make upload PROFILE=1" sends over
+the serial port (see profile.h): it finds every frame in a capture of
+the port, skipping the text printed around them and any frame whose
+checksum is wrong, and prints for each phase of the game loop how often
+it ran, its mean, shortest and longest time and its share of the loop,
+then a histogram of its run times. "-t" also prints a timeline with the
+longest run of every phase in each window, and "-j" writes the same
+timeline as counters for chrome://tracing or Perfetto.
+
+Capture the port with, for example:
+  stty -F /dev/ttyACM0 500000 raw -echo; cat /dev/ttyACM0 > game.prof
+
+Usage: profdump [-t] [-j trace.json] [capture]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "profile.h"
+
+static const char* phaseNames[NUM_PHASES] = {"loop", "input", "rules", "draw", "hud", "log", "export",
+                                             "match", "clear", "gravity", "grid", "preview", "save"};
+
+struct Window {
+    uint16_t number;
+    uint32_t endMs;
+    PhaseStats phase[NUM_PHASES];
+};
+
+static uint32_t readLittle(const uint8_t* bytes, int count) {
+    uint32_t value = 0;
+    for (int i = count - 1; i >= 0; --i) {
+        value = (value << 8) | bytes[i];
+    }
+    return value;
+}
+
+/*Decodes the frame at bytes (PROFILE_FRAME_SIZE of them, header
+included). Returns false if it is not a whole, correct frame.*/
+static bool decodeFrame(const uint8_t* bytes, Window* window) {
+    if (bytes[0] != 'M' || bytes[1] != 'C' || bytes[2] != 'P' || bytes[3] != PROFILE_VERSION) {
+        return false;
+    }
+    const uint8_t* p = bytes + 4;
+    int size = PROFILE_FRAME_SIZE - 4 - 2;
+    uint16_t a = 0, b = 0;
+    for (int i = 0; i < size; ++i) {
+        a = (a + p[i]) % 255;
+        b = (b + a) % 255;
+    }
+    if (readLittle(p + size, 2) != (uint32_t) ((b << 8) | a) || p[6] != NUM_PHASES) {
+        return false;
+    }
+    window->number = readLittle(p, 2);
+    window->endMs = readLittle(p + 2, 4);
+    p += 7;
+    for (int k = 0; k < NUM_PHASES; ++k, p += PROFILE_PHASE_SIZE) {
+        PhaseStats* stats = &window->phase[k];
+        stats->runs = readLittle(p, 2);
+        stats->min = readLittle(p + 2, 4);
+        stats->max = readLittle(p + 6, 4);
+        stats->total = readLittle(p + 10, 4);
+        memcpy(stats->buckets, p + 14, PROFILE_BUCKETS);
+    }
+    return true;
+}
+
+static double micros(double cycles) {
+    return cycles * 1e6 / PROFILE_CPU_HZ;
+}
+
+int main(int argc, char** argv) {
+    bool timeline = false;
+    const char* tracePath = 0;
+    const char* path = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-t") == 0) {
+            timeline = true;
+        }
+        else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        }
+        else if (argv[i][0] != '-' && path == 0) {
+            path = argv[i];
+        }
+        else {
+            fprintf(stderr, "usage: profdump [-t] [-j trace.json] [capture]\n");
+            return 2;
+        }
+    }
+    FILE* file = path != 0 ? fopen(path, "rb") : stdin;
+    if (file == 0) {
+        perror(path);
+        return 1;
+    }
+    std::vector<uint8_t> bytes;
+    uint8_t buffer[4096];
+    size_t count;
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        bytes.insert(bytes.end(), buffer, buffer + count);
+    }
+
+    std::vector<Window> windows;
+    long skipped = 0; // bytes that were not part of a good frame
+    size_t i = 0;
+    while (i + PROFILE_FRAME_SIZE <= bytes.size()) {
+        Window window;
+        if (decodeFrame(&bytes[i], &window)) {
+            windows.push_back(window);
+            i += PROFILE_FRAME_SIZE;
+        }
+        else {
+            ++skipped;
+            ++i;
+        }
+    }
+    skipped += bytes.size() - i;
+    if (windows.empty()) {
+        fprintf(stderr, "no profile frames found\n");
+        return 1;
+    }
+    long missing = 0;
+    for (size_t w = 1; w < windows.size(); ++w) {
+        missing += (uint16_t) (windows[w].number - windows[w-1].number - 1);
+    }
+
+    // the whole capture, phase by phase
+    Window all;
+    memset(&all, 0, sizeof(all));
+    double totals[NUM_PHASES] = {0};
+    long buckets[NUM_PHASES][PROFILE_BUCKETS] = {{0}};
+    long runs[NUM_PHASES] = {0};
+    for (int k = 0; k < NUM_PHASES; ++k) {
+        all.phase[k].min = 0xFFFFFFFF;
+    }
+    for (size_t w = 0; w < windows.size(); ++w) {
+        for (int k = 0; k < NUM_PHASES; ++k) {
+            const PhaseStats* stats = &windows[w].phase[k];
+            if (stats->runs == 0) {
+                continue;
+            }
+            runs[k] += stats->runs;
+            totals[k] += stats->total;
+            if (stats->min < all.phase[k].min) {
+                all.phase[k].min = stats->min;
+            }
+            if (stats->max > all.phase[k].max) {
+                all.phase[k].max = stats->max;
+            }
+            for (int b = 0; b < PROFILE_BUCKETS; ++b) {
+                buckets[k][b] += stats->buckets[b];
+            }
+        }
+    }
+
+    printf("%zu windows of %d ms (%ld missing), %ld bytes of other output skipped\n\n", windows.size(),
+           PROFILE_WINDOW_MS, missing, skipped);
+    printf("%-8s %10s %10s %10s %10s %8s\n", "phase", "runs", "mean us", "min us", "max us", "of loop");
+    for (int k = 0; k < NUM_PHASES; ++k) {
+        if (runs[k] == 0) {
+            printf("%-8s %10d\n", phaseNames[k], 0);
+            continue;
+        }
+        printf("%-8s %10ld %10.1f %10.1f %10.1f %7.1f%%\n", phaseNames[k], runs[k], micros(totals[k] / runs[k]),
+               micros(all.phase[k].min), micros(all.phase[k].max), 100.0 * totals[k] / totals[PhaseLoop]);
+    }
+
+    for (int k = 0; k < NUM_PHASES; ++k) {
+        long most = 0;
+        for (int b = 0; b < PROFILE_BUCKETS; ++b) {
+            if (buckets[k][b] > most) {
+                most = buckets[k][b];
+            }
+        }
+        if (most == 0) {
+            continue;
+        }
+        printf("\n%s\n", phaseNames[k]);
+        for (int b = 0; b < PROFILE_BUCKETS; ++b) {
+            if (buckets[k][b] == 0) {
+                continue;
+            }
+            // the first and last buckets also hold everything below and above them
+            const char* bound = b == 0 ? "<" : ">=";
+            double low = micros(b == 0 ? 2 << PROFILE_BUCKET_SHIFT : 1L << (b + PROFILE_BUCKET_SHIFT));
+            int bar = (int) (50 * buckets[k][b] / most);
+            printf("  %2s %9.1f us %8ld %.*s\n", bound, low, buckets[k][b], bar > 0 ? bar : 1,
+                   "##################################################");
+        }
+    }
+
+    if (timeline) {
+        printf("\nthe longest run in each window, in us\n%6s %9s", "window", "ms");
+        for (int k = 0; k < NUM_PHASES; ++k) {
+            printf(" %8s", phaseNames[k]);
+        }
+        printf("\n");
+        for (size_t w = 0; w < windows.size(); ++w) {
+            printf("%6u %9u", windows[w].number, windows[w].endMs);
+            for (int k = 0; k < NUM_PHASES; ++k) {
+                printf(" %8.0f", micros(windows[w].phase[k].max));
+            }
+            printf("\n");
+        }
+    }
+
+    if (tracePath != 0) {
+        FILE* trace = fopen(tracePath, "w");
+        if (trace == 0) {
+            perror(tracePath);
+            return 1;
+        }
+        fprintf(trace, "{\"traceEvents\": [\n");
+        for (size_t w = 0; w < windows.size(); ++w) {
+            for (int k = 0; k < NUM_PHASES; ++k) {
+                const PhaseStats* stats = &windows[w].phase[k];
+                double mean = stats->runs > 0 ? micros((double) stats->total / stats->runs) : 0;
+                fprintf(trace, "%s{\"name\": \"%s\", \"ph\": \"C\", \"ts\": %u000, \"pid\": 1, "
+                        "\"args\": {\"mean us\": %.1f, \"max us\": %.1f, \"busy %%\": %.2f}}",
+                        w + k == 0 ? "" : ",\n", phaseNames[k], windows[w].endMs, mean, micros(stats->max),
+                        100.0 * stats->total / (PROFILE_CPU_HZ / 1000.0 * PROFILE_WINDOW_MS));
+            }
+        }
+        fprintf(trace, "\n]}\n");
+        fclose(trace);
+    }
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*Plays games with random joystick and button inputs and saves their logs,
+to make an archive for verify and replay to check. Each game is played
+by a player that moves the stack and rotates it at random and holds the
+joystick down now and then, so the games are short but go through every
+part of the rules. Game n uses seed n+1, and the files are named
+Gnnnnn.LOG like the logs the Arduino writes to the SD card.
+
+Usage: record count directory [difficulty]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+#include <vector>
+
+#include "gamelog.h"
+#include "host/threadpool.h"
+
+static thread_local std::vector<uint8_t>* recording;
+
+static void writeRecording(const uint8_t* bytes, uint8_t count) {
+    recording->insert(recording->end(), bytes, bytes + count);
+}
+
+/*Plays game n and returns its log.*/
+static std::vector<uint8_t> playGame(size_t n, int difficulty) {
+    std::vector<uint8_t> bytes;
+    recording = &bytes;
+    std::mt19937 player(n); // the player's choices, the seed picks the stacks
+    uint32_t seed = n + 1;
+    Session session;
+    resetSession(&session, difficulty, seed);
+    LogWriter log;
+    logBegin(&log, writeRecording, difficulty, seed);
+    while (session.phase != Over) {
+        if (player() % 16 == 0) {
+            int input = player() % 3;
+            int value = 1;
+            if (input == MoveInput) {
+                value = (int) (player() % 3) - 1;
+            }
+            else if (input == DropInput) {
+                value = player() % 4 == 0;
+            }
+            sessionInput(&session, input, value);
+            logInput(&log, session.tick, input, value);
+        }
+        sessionTick(&session);
+    }
+    logEnd(&log, &session);
+    return bytes;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: record count directory [difficulty]\n");
+        return 2;
+    }
+    size_t count = atol(argv[1]);
+    const char* directory = argv[2];
+    int difficulty = argc > 3 ? atoi(argv[3]) : 4;
+    if (difficulty < 3 || difficulty > 6) {
+        fprintf(stderr, "difficulty must be between 3 and 6\n");
+        return 2;
+    }
+
+    std::vector<std::vector<uint8_t> > logs(count);
+    WorkPool pool;
+    pool.run(count, [&](size_t n) { logs[n] = playGame(n, difficulty); });
+
+    size_t total = 0;
+    for (size_t n = 0; n < count; ++n) {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/G%05zu.LOG", directory, n);
+        FILE* file = fopen(path, "wb");
+        if (file == 0) {
+            perror(path);
+            return 1;
+        }
+        fwrite(logs[n].data(), 1, logs[n].size(), file);
+        fclose(file);
+        total += logs[n].size();
+    }
+    printf("%zu games recorded in %s, %zu bytes\n", count, directory, total);
+    return 0;
+}
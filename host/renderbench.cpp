@@ -0,0 +1,280 @@
+/*Draws scripted games on the recording display in host/mock/ and reports
+what the screen costs over SPI: the bytes and the time they take to send
+for the game screen, for every tick, for every step of a cascade and for
+whole cascades, and which library calls and bursts (spiqueue.h) they
+come from. Each tick is drawn the way tickStep() and the HUD and banner
+tasks in columns.cpp draw it. The steps of a cascade are the ones
+planLanding() plans for each landing (host/planwatch.h), which also
+gives the cells each of them redraws; a step shown otherwise than
+planned fails the run.
+
+The games are played by the greedy and the random player of
+host/player.h on every difficulty with fixed seeds, so the numbers only
+change when the drawing does. Each figure has a budget below; renderbench
+lists any that went over and exits with 1, so a rendering change that
+sends more than it did fails "make bench". Lower a budget when the
+drawing gets cheaper.
+
+Usage: renderbench [-o frame.ppm] [-t trace] [games per difficulty and player]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include <Adafruit_ST7735.h>
+
+#include "display.h"
+#include "playfield.h"
+#include "blit.h"
+#include "spiqueue.h"
+#include "render.h"
+#include "host/player.h"
+#include "host/planwatch.h"
+#include "host/mock/panel.h"
+
+#define REACTION_TICKS 20 // a quick human
+#define MAX_TICKS (12L * LEVEL_TICKS) // games that last longer are stopped after 12 minutes
+
+Adafruit_ST7735 tft = Adafruit_ST7735(TFT_CS, TFT_DC, TFT_RST);
+
+// bytes that a figure may reach before it counts as a regression
+struct Budget {
+    const char* name;
+    double limit;
+};
+
+static const Budget budgets[] = {
+    {"game screen", 75000},
+    {"mean tick", 350},
+    {"p99 tick", 2100},
+    {"mean cascade step", 1060},
+    {"max cascade step", 8200},
+    {"mean cascade", 4150},
+    {"game over", 7900},
+};
+#define NUM_BUDGETS (sizeof(budgets) / sizeof(budgets[0]))
+
+struct Spread {
+    double mean;
+    long p99;
+    long max;
+};
+
+/*The mean, 99th percentile and maximum of a list of byte counts.*/
+static Spread spread(std::vector<long>& bytes) {
+    Spread s = {0, 0, 0};
+    if (bytes.empty()) {
+        return s;
+    }
+    std::sort(bytes.begin(), bytes.end());
+    double total = 0;
+    for (size_t i = 0; i < bytes.size(); ++i) {
+        total += bytes[i];
+    }
+    s.mean = total / bytes.size();
+    s.p99 = bytes[(bytes.size() - 1) * 99 / 100];
+    s.max = bytes.back();
+    return s;
+}
+
+static std::vector<long> tickBytes;
+static std::vector<long> stepBytes; // the ticks that landed a stack or showed a step of a cascade
+static std::vector<long> cascadeBytes; // from a stack landing to the next one falling
+static std::vector<long> screenBytes;
+static std::vector<long> overBytes;
+static long cascadeSteps = 0;
+static long stepCells = 0; // redrawn by the steps of cascades, as planned
+static long stepCellBytes = 0; // sent by those steps
+static PlanWatch watch;
+
+/*The cells a step of a cascade changes.*/
+static int countCells(const CascadeStep* step) {
+    int count = 0;
+    for (int i = 0; i < NUM_COLS; ++i) {
+        count += __builtin_popcount(step->cleared[i] | step->moved[i]);
+    }
+    return count;
+}
+
+/*Plays and draws one game, adding what each part of it sent to the lists.*/
+static void playGame(int policy, int difficulty, uint32_t seed) {
+    tft.initR(INITR_BLACKTAB);
+    blitInit();
+
+    Session session;
+    resetSession(&session, difficulty, seed);
+    AiSettings settings = {1, 0, 0};
+    Player player;
+    resetPlayer(&player, policy, &settings, 0, REACTION_TICKS, seed);
+
+    long start = panelStats.bytes;
+    drawGameScreen(&session);
+    screenBytes.push_back(panelStats.bytes - start);
+    resetPlayfield(); // as startStep() does once the screen is up
+    startDrawing(&session);
+
+    long bannerTicks = 0;
+    long cascade = -1; // bytes of the cascade under way, or -1
+    while (session.phase != Over && (long) session.tick < MAX_TICKS) {
+        bool falling = session.phase == Falling;
+        watchBefore(&watch, &session);
+        playerTick(&player, &session); // which runs the tick
+        const CascadeStep* planned = watchAfter(&watch, &session);
+
+        start = panelStats.bytes;
+        bool step = planned != 0 || (falling && session.phase != Falling);
+        if (drawSession(&session)) {
+            drawLevelBanner(true);
+            bannerTicks = BANNER_DELAY / TICK_MS;
+        }
+        else if (bannerTicks > 0 && --bannerTicks == 0) {
+            drawLevelBanner(false);
+        }
+        if (session.tick % (HUD_PERIOD / TICK_MS) == 0) {
+            refreshHud(&session);
+        }
+        long bytes = panelStats.bytes - start;
+        tickBytes.push_back(bytes);
+
+        if (cascade < 0 && session.phase != Falling) { // a stack has landed
+            cascade = 0;
+        }
+        if (cascade >= 0) {
+            cascade += bytes;
+            if (step) {
+                stepBytes.push_back(bytes);
+                ++cascadeSteps;
+            }
+            if (planned != 0) {
+                stepCells += countCells(planned);
+                stepCellBytes += bytes;
+            }
+            if (session.phase != Checking) {
+                cascadeBytes.push_back(cascade);
+                cascade = -1;
+            }
+        }
+    }
+
+    start = panelStats.bytes;
+    refreshHud(&session);
+    drawGameOver();
+    overBytes.push_back(panelStats.bytes - start);
+}
+
+/*Prints one line of figures in bytes and in milliseconds on the bus.*/
+static void report(const char* name, double bytes) {
+    printf("%-20s %10.0f %9.2f\n", name, bytes, bytes * SPI_BYTE_US / 1000);
+}
+
+int main(int argc, char** argv) {
+    const char* imagePath = 0;
+    const char* tracePath = 0;
+    int games = 2;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            imagePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        }
+        else if (argv[i][0] != '-' && atoi(argv[i]) > 0) {
+            games = atoi(argv[i]);
+        }
+        else {
+            fprintf(stderr, "usage: renderbench [-o frame.ppm] [-t trace] [games per difficulty and player]\n");
+            return 2;
+        }
+    }
+    if (tracePath != 0) {
+        panelTrace = fopen(tracePath, "w");
+        if (panelTrace == 0) {
+            perror(tracePath);
+            return 1;
+        }
+    }
+
+    PanelStats total;
+    memset(&total, 0, sizeof(total));
+    resetWatch(&watch);
+    int played = 0;
+    for (int policy = RandomPolicy; policy <= GreedyPolicy; ++policy) {
+        for (int difficulty = 3; difficulty <= 6; ++difficulty) {
+            for (int n = 0; n < games; ++n) {
+                playGame(policy, difficulty, 1000 * difficulty + n + 1);
+                for (int s = 0; s < PANEL_SOURCES; ++s) {
+                    total.from[s].calls += panelStats.from[s].calls;
+                    total.from[s].windows += panelStats.from[s].windows;
+                    total.from[s].bytes += panelStats.from[s].bytes;
+                }
+                total.windows += panelStats.windows;
+                total.bytes += panelStats.bytes;
+                if (played++ == 0 && imagePath != 0 && !panelWritePPM(imagePath)) {
+                    perror(imagePath);
+                }
+            }
+        }
+    }
+    if (panelTrace != 0) {
+        fclose(panelTrace);
+    }
+
+    long overTick = 0;
+    for (size_t i = 0; i < tickBytes.size(); ++i) {
+        overTick += tickBytes[i] * SPI_BYTE_US > TICK_US;
+    }
+    Spread ticks = spread(tickBytes);
+    Spread steps = spread(stepBytes);
+    Spread cascades = spread(cascadeBytes);
+    Spread screens = spread(screenBytes);
+    Spread overs = spread(overBytes);
+
+    printf("%d games, %zu ticks, %zu cascades of %ld steps, at %.0f us a byte\n\n", played, tickBytes.size(),
+           cascadeBytes.size(), cascadeSteps, SPI_BYTE_US);
+    printf("%-20s %10s %9s\n", "", "bytes", "ms");
+    report("game screen", screens.mean);
+    report("mean tick", ticks.mean);
+    report("p99 tick", ticks.p99);
+    report("max tick", ticks.max);
+    report("mean cascade step", steps.mean);
+    report("p99 cascade step", steps.p99);
+    report("max cascade step", steps.max);
+    report("mean cascade", cascades.mean);
+    report("p99 cascade", cascades.p99);
+    report("max cascade", cascades.max);
+    report("game over", overs.mean);
+    printf("%ld ticks (%.2f%%) take longer than the %d ms tick to send\n", overTick,
+           100.0 * overTick / tickBytes.size(), TICK_MS);
+    printf("the planned steps of %ld landings redraw %ld cells, %.0f bytes a cell\n\n", watch.landings, stepCells,
+           stepCells > 0 ? (double) stepCellBytes / stepCells : 0.0);
+
+    printf("%-20s %10s %9s %12s %6s\n", "sent by", "calls", "windows", "bytes", "share");
+    for (int s = 0; s < PANEL_SOURCES; ++s) {
+        printf("%-20s %10ld %9ld %12ld %5.1f%%\n", panelSourceName(s), total.from[s].calls, total.from[s].windows,
+               total.from[s].bytes, 100.0 * total.from[s].bytes / total.bytes);
+    }
+    printf("%-20s %10s %9ld %12ld\n\n", "total", "", total.windows, total.bytes);
+
+    // the figures checked against their budgets, in the order of budgets[]
+    double figures[NUM_BUDGETS] = {screens.mean, ticks.mean, (double) ticks.p99, steps.mean, (double) steps.max,
+                                   cascades.mean, overs.mean};
+    int failed = 0;
+    for (size_t b = 0; b < NUM_BUDGETS; ++b) {
+        if (figures[b] > budgets[b].limit) {
+            printf("over budget: %s sends %.0f bytes, the budget is %.0f\n", budgets[b].name, figures[b],
+                   budgets[b].limit);
+            ++failed;
+        }
+    }
+    if (watch.mismatches > 0) {
+        printf("%ld steps or cascades went otherwise than planLanding() planned\n", watch.mismatches);
+        ++failed;
+    }
+    if (failed > 0) {
+        return 1;
+    }
+    printf("all within budget\n");
+    return 0;
+}
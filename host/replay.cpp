@@ -0,0 +1,120 @@
+/*Replays a game log recorded by the Arduino (from the serial port or the
+SD card) and checks that the game ends with the recorded score, level
+and board. With -t it prints every tick in which something happened,
+with how long the host took to run it, so a slow cascade can be followed
+tick by tick. The slowest ticks are always listed at the end.
+
+Usage: replay [-t] log*/
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include "gamelog.h"
+#include "host/logfile.h"
+
+static const char* resultNames[] = {"matched", "DIVERGED", "truncated", "not a game log"};
+
+/*Prints what happened in a tick, going by how the session changed.*/
+static void traceTick(const Session* before, const Session* after, double us) {
+    char what[128] = "";
+    if (before->phase == Falling && after->phase != Falling) {
+        // what the landing sets off, worked out in advance
+        Shade stack[3] = {before->Bcolour, before->Mcolour, before->Tcolour};
+        CascadePlan plan;
+        planLanding(&before->game, after->col, stackRow(after->y), stack, &plan);
+        snprintf(what, sizeof(what), "stack %d landed in column %d", before->stacks, after->col + 1);
+        if (plan.steps > 0) {
+            snprintf(what + strlen(what), sizeof(what) - strlen(what), ", a cascade of %d for %d points",
+                     plan.steps, plan.points);
+        }
+    }
+    else if (after->game.score != before->game.score) {
+        snprintf(what, sizeof(what), "%d blocks removed, score %d",
+                 (after->game.score - before->game.score) / after->game.level, after->game.score);
+    }
+    else if (after->stacks != before->stacks) {
+        snprintf(what, sizeof(what), "stack %d comes in", after->stacks);
+    }
+    else if (after->col != before->col) {
+        snprintf(what, sizeof(what), "moved to column %d", after->col + 1);
+    }
+    if (after->game.level != before->game.level) {
+        strncat(what, what[0] ? ", level up" : "level up", sizeof(what) - strlen(what) - 1);
+    }
+    if (after->phase == Over) {
+        strncat(what, what[0] ? ", game over" : "game over", sizeof(what) - strlen(what) - 1);
+    }
+    if (what[0]) {
+        printf("tick %7u  %8.1f us  %s\n", before->tick, us, what);
+    }
+}
+
+int main(int argc, char** argv) {
+    bool trace = false;
+    const char* path = 0;
+    for (int k = 1; k < argc; ++k) {
+        if (strcmp(argv[k], "-t") == 0) {
+            trace = true;
+        }
+        else {
+            path = argv[k];
+        }
+    }
+    if (path == 0) {
+        fprintf(stderr, "usage: replay [-t] log\n");
+        return 2;
+    }
+    LogBuffer buffer;
+    if (!loadLog(path, &buffer)) {
+        perror(path);
+        return 2;
+    }
+
+    static Session session;
+    Replay replay;
+    if (!replayBegin(&replay, readLogBuffer, &buffer, &session)) {
+        printf("%s: %s\n", path, resultNames[ReplayBadLog]);
+        return 1;
+    }
+    printf("difficulty %d\n", session.game.difficulty);
+
+    typedef std::chrono::steady_clock Clock;
+    std::vector<std::pair<double, uint32_t> > slowest; // host time and tick
+    double total = 0;
+    while (true) {
+        Session before = session;
+        Clock::time_point start = Clock::now();
+        bool running = replayTick(&replay, &session);
+        double us = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+        if (!running) {
+            break;
+        }
+        total += us;
+        slowest.push_back(std::make_pair(us, before.tick));
+        if (trace) {
+            traceTick(&before, &session, us);
+        }
+        memset(session.ChangedMask, 0, sizeof(session.ChangedMask)); // as the display would
+    }
+    int result = replayFinish(&replay, &session);
+
+    printf("%s: %s\n", path, resultNames[result]);
+    printf("ticks %u (%.1f s of play), stacks %d\n", session.tick, session.tick * TICK_MS / 1000.0, session.stacks);
+    printf("score %d, level %d, board hash %08x", session.game.score, session.game.level, boardHash(&session.game));
+    if (replay.nextCode == LOG_END) {
+        printf(" (recorded %d, %d, %08x)", replay.score, replay.level, replay.hash);
+    }
+    printf("\nhost time %.1f ms, %.0f ticks per second\n", total / 1000, session.tick / (total / 1e6));
+
+    std::sort(slowest.rbegin(), slowest.rend());
+    printf("slowest ticks:");
+    for (size_t k = 0; k < slowest.size() && k < 5; ++k) {
+        printf(" %u (%.1f us)", slowest[k].second, slowest[k].first);
+    }
+    printf("\n");
+    return result == ReplayMatched ? 0 : 1;
+}
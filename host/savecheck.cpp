@@ -0,0 +1,159 @@
+/*Runs savegame.cpp and the scheduler against the SD card model in
+host/mock/SD.h, which appends and truncates the way the library does,
+and checks what a later start reads back: the newest of several
+snapshots written in turn to both slots, the one before it when the
+newest is damaged or cut off half way through its write, nothing after
+clearSaves(), and the newest of two high score tables. It also checks
+that a snapshot is not written while the next tick is too close. Exits
+with 1 if any of them is not what was saved.
+
+Usage: savecheck [snapshots]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+
+#include <SD.h>
+
+#include "scheduler.h"
+#include "savegame.h"
+
+#define SAVE_EVERY 37 // ticks between the snapshots
+
+static unsigned long now = 0; // the clock of the scheduler, in ms
+
+unsigned long millis() {
+    return now;
+}
+
+static long spareUs = SAVE_SPARE_US; // what the spare time hook says is left before the tick
+
+static long spareTime() {
+    return spareUs;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+    if (!ok) {
+        printf("failed: %s\n", what);
+        ++failures;
+    }
+}
+
+/*Runs the main loop for one tick, as often as once a millisecond.*/
+static void runTick() {
+    for (int ms = 0; ms < TICK_MS; ++ms) {
+        runTasks();
+        ++now;
+    }
+}
+
+/*Starts again, as the Arduino does when it is switched on, and checks
+that the newest good snapshot on the card is expected.*/
+static void checkResume(const uint8_t* expected, uint16_t sequence, uint32_t seed, const char* what) {
+    savegameBegin();
+    Session loaded;
+    uint32_t loadedSeed;
+    if (!findSnapshot(&loaded, &loadedSeed)) {
+        check(expected == 0, what);
+        return;
+    }
+    uint8_t bytes[SNAPSHOT_SIZE];
+    saveSnapshot(&loaded, loadedSeed, sequence, bytes);
+    check(expected != 0 && loadedSeed == seed && memcmp(bytes, expected, SNAPSHOT_SIZE) == 0, what);
+}
+
+/*Starts a snapshot with no time to spare before the tick and checks that
+none of it goes to the card until there is.*/
+static void checkSpareTime() {
+    Session session;
+    resetSession(&session, 4, 1);
+    saveSetSpareHook(spareTime);
+    spareUs = SAVE_SPARE_US - 1;
+    saveGame(&session, 1);
+    runTick();
+    check(SD.files.empty(), "a snapshot waits while the next tick is too close");
+    spareUs = SAVE_SPARE_US;
+    runTick();
+    check(SD.files.size() == 1 && SD.files.begin()->second.size() == SNAPSHOT_SIZE,
+          "a snapshot is written once there is time to spare");
+    saveSetSpareHook(0);
+    clearSaves();
+}
+
+/*Writes two high score tables, the second with a new best, and checks
+that the second is the one a later start reads.*/
+static void checkHighScores() {
+    Session session;
+    resetSession(&session, 4, 1);
+    session.game.score = 1200;
+    recordHighScore(&session);
+    session.game.score = 3400;
+    recordHighScore(&session);
+    HighScoreTable expected = highScores;
+    memset(&highScores, 0, sizeof(highScores));
+    savegameBegin();
+    check(memcmp(&highScores, &expected, sizeof(highScores)) == 0 && highScores.place[0].score == 3400,
+          "the newest high score table is read back");
+}
+
+int main(int argc, char** argv) {
+    int saves = argc > 1 ? atoi(argv[1]) : 12;
+    if (saves < 3) {
+        fprintf(stderr, "usage: savecheck [snapshots, at least 3]\n");
+        return 2;
+    }
+    SD.begin();
+    savegameBegin();
+    checkResume(0, 0, 0, "an empty card has nothing to resume");
+
+    uint32_t seed = 12345;
+    std::mt19937 player(seed);
+    Session session;
+    resetSession(&session, 5, seed);
+    uint8_t newest[SNAPSHOT_SIZE];
+    uint8_t before[SNAPSHOT_SIZE];
+    for (int n = 1; n <= saves; ++n) {
+        for (int t = 0; t < SAVE_EVERY && session.phase != Over; ++t) {
+            if (player() % 16 == 0) {
+                sessionInput(&session, MoveInput, (int) (player() % 3) - 1);
+            }
+            sessionTick(&session);
+            runTick();
+        }
+        memcpy(before, newest, SNAPSHOT_SIZE);
+        saveSnapshot(&session, seed, n, newest);
+        saveGame(&session, seed);
+        if (n < saves) {
+            runTick(); // enough for every step of the write
+        }
+    }
+
+    // the power goes off once the last snapshot's file has been opened
+    runTasks();
+    std::map<std::string, std::vector<uint8_t> > cut = SD.files;
+    runTick();
+    std::map<std::string, std::vector<uint8_t> > card = SD.files;
+    SD.files = cut;
+    checkResume(before, saves - 1, seed, "a snapshot cut off while it is written leaves the one before it");
+
+    SD.files = card;
+    checkResume(newest, saves, seed, "the newest snapshot is the one resumed");
+    check(SD.files["SAVEA.DAT"].size() == SNAPSHOT_SIZE && SD.files["SAVEB.DAT"].size() == SNAPSHOT_SIZE,
+          "each slot holds one snapshot");
+
+    SD.files[saves & 1 ? "SAVEB.DAT" : "SAVEA.DAT"][40] ^= 1;
+    checkResume(before, saves - 1, seed, "a damaged snapshot leaves the one before it");
+
+    clearSaves();
+    checkResume(0, 0, 0, "nothing is left to resume after clearSaves");
+
+    checkSpareTime();
+
+    checkHighScores();
+
+    printf("%d snapshots written to alternate slots: %d checks failed\n", saves, failures);
+    return failures > 0 ? 1 : 0;
+}
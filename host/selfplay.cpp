@@ -0,0 +1,211 @@
+/*Monte Carlo self-play for tuning the difficulty and the fall speed.
+Plays many games of every difficulty (3 to 6 colours, as chosen on the
+menu) with every speed curve asked for, spread over all cores, and
+prints how long the games lasted and how they scored.
+
+Every game is played by a simulated player (player.cpp) with a reaction
+time, so a curve that gets too fast shows up as stacks that land before
+the player gets them to their column. The player can be
+  random  any column and rotation
+  greedy  the best placement of each stack on its own
+  ai      the best placement looking at NEXT as well (depth 2)
+
+Each game gets its own random streams, made from the master seed and the
+number of the game, for both the stacks and the player. The results do
+not depend on how many threads there are or which one ran which game.
+
+Usage: selfplay [-p random|greedy|ai] [-n games per cell] [-l difficulties, e.g. 3-6]
+                [-c curves, e.g. table,original] [-r reaction ms] [-x max minutes]
+                [-s seed] [-j threads]*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "host/player.h"
+
+/*The speed of the old frame loop, which waited (100/level - level) ms
+before moving the stack a pixel and so had no speed left after level 9.*/
+static uint32_t originalSpeed(int level) {
+    int delay = 100 / level - level;
+    if (delay < 1) {
+        return MAX_FALL_SPEED;
+    }
+    uint32_t speed = PIXELS_PER_SECOND(1000.0 / delay);
+    return speed < MAX_FALL_SPEED ? speed : MAX_FALL_SPEED;
+}
+
+/*15 px/s faster every level.*/
+static uint32_t linearSpeed(int level) {
+    uint32_t speed = PIXELS_PER_SECOND(10 + 15 * (level - 1));
+    return speed < MAX_FALL_SPEED ? speed : MAX_FALL_SPEED;
+}
+
+/*20% faster every level from 10 px/s, so it speeds up smoothly but only
+reaches the table's level 10 speed at level 19.*/
+static uint32_t smoothSpeed(int level) {
+    double pixels = 10;
+    for (int k = 1; k < level && pixels < 1000; ++k) {
+        pixels *= 1.2;
+    }
+    uint32_t speed = PIXELS_PER_SECOND(pixels);
+    return speed < MAX_FALL_SPEED ? speed : MAX_FALL_SPEED;
+}
+
+struct Curve {
+    const char* name;
+    SpeedCurve speed;
+};
+
+static const Curve curves[] = {
+    {"table", fallSpeed}, // what the game uses, see engine.cpp
+    {"original", originalSpeed},
+    {"linear", linearSpeed},
+    {"smooth", smoothSpeed},
+};
+static const int NUM_CURVES = sizeof(curves) / sizeof(curves[0]);
+
+static const char* policyNames[] = {"random", "greedy", "ai"};
+
+struct Outcome {
+    uint32_t ticks; // how long the game lasted
+    int score;
+    int level;
+    bool finished; // it ended in game over rather than at the time limit
+};
+
+/*splitmix64, to turn the master seed and a game number into the seeds
+of that game's random streams.*/
+static uint64_t mixSeed(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/*The value below which a fraction of the sorted values fall.*/
+template <typename T>
+static T percentile(const std::vector<T>& sorted, double fraction) {
+    return sorted[(size_t) (fraction * (sorted.size() - 1) + 0.5)];
+}
+
+int main(int argc, char** argv) {
+    int policy = GreedyPolicy;
+    long games = 1000;
+    int lowest = 3;
+    int highest = 6;
+    std::vector<int> chosen;
+    int reactionMs = 300;
+    double maxMinutes = 30;
+    uint64_t seed = 1;
+    unsigned threads = 0;
+    for (int k = 1; k + 1 < argc; k += 2) {
+        const char* value = argv[k + 1];
+        if (strcmp(argv[k], "-p") == 0) {
+            policy = -1;
+            for (int p = 0; p < 3; ++p) {
+                if (strcmp(value, policyNames[p]) == 0) {
+                    policy = p;
+                }
+            }
+        }
+        else if (strcmp(argv[k], "-n") == 0) {
+            games = atol(value);
+        }
+        else if (strcmp(argv[k], "-l") == 0) {
+            lowest = atoi(value);
+            const char* dash = strchr(value, '-');
+            highest = dash ? atoi(dash + 1) : lowest;
+        }
+        else if (strcmp(argv[k], "-c") == 0) {
+            std::string list = value;
+            for (int c = 0; c < NUM_CURVES; ++c) {
+                if (("," + list + ",").find(std::string(",") + curves[c].name + ",") != std::string::npos) {
+                    chosen.push_back(c);
+                }
+            }
+        }
+        else if (strcmp(argv[k], "-r") == 0) {
+            reactionMs = atoi(value);
+        }
+        else if (strcmp(argv[k], "-x") == 0) {
+            maxMinutes = atof(value);
+        }
+        else if (strcmp(argv[k], "-s") == 0) {
+            seed = strtoull(value, 0, 0);
+        }
+        else if (strcmp(argv[k], "-j") == 0) {
+            threads = atoi(value);
+        }
+    }
+    if (chosen.empty()) {
+        chosen.push_back(0);
+    }
+    if (policy < 0 || games < 1 || lowest < 3 || highest > 6 || lowest > highest) {
+        fprintf(stderr, "usage: selfplay [-p random|greedy|ai] [-n games] [-l 3-6] [-c table,original,linear,smooth]"
+                        " [-r reaction ms] [-x max minutes] [-s seed] [-j threads]\n");
+        return 2;
+    }
+
+    int difficulties = highest - lowest + 1;
+    long cells = difficulties * (long) chosen.size();
+    std::vector<Outcome> outcomes(cells * games);
+    uint32_t maxTicks = (uint32_t) (maxMinutes * 60000 / TICK_MS);
+    AiSettings settings = {2, 0, 0};
+
+    WorkPool pool(threads);
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    pool.run(outcomes.size(), [&](size_t n) {
+        long cell = n / games;
+        int difficulty = lowest + cell % difficulties;
+        const Curve& curve = curves[chosen[cell / difficulties]];
+        uint64_t streams = mixSeed(seed ^ mixSeed(n));
+
+        Session session;
+        resetSession(&session, difficulty, (uint32_t) streams);
+        session.speed = curve.speed;
+        Player player;
+        resetPlayer(&player, policy, &settings, 0, reactionMs / TICK_MS, streams >> 32);
+        while (session.phase != Over && session.tick < maxTicks) {
+            playerTick(&player, &session);
+        }
+        Outcome outcome = {session.tick, session.game.score, session.game.level, session.phase == Over};
+        outcomes[n] = outcome;
+    });
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    printf("%s player, %d ms reaction, %ld games per cell, at most %.0f minutes each\n\n", policyNames[policy],
+           reactionMs, games, maxMinutes);
+    printf("%-9s %4s | %27s | %22s | %7s %6s\n", "", "", "survival s (p10 p50 p90)", "score (p10 p50 p90)",
+           "level", "ended");
+    long long ticks = 0;
+    for (long cell = 0; cell < cells; ++cell) {
+        std::vector<double> seconds;
+        std::vector<int> scores;
+        double levels = 0;
+        long finished = 0;
+        for (long g = 0; g < games; ++g) {
+            const Outcome& o = outcomes[cell * games + g];
+            seconds.push_back(o.ticks * TICK_MS / 1000.0);
+            scores.push_back(o.score);
+            levels += o.level;
+            finished += o.finished;
+            ticks += o.ticks;
+        }
+        std::sort(seconds.begin(), seconds.end());
+        std::sort(scores.begin(), scores.end());
+        printf("%-9s %4d | %8.1f %8.1f %9.1f | %6d %7d %7d | %7.1f %5.1f%%\n",
+               curves[chosen[cell / difficulties]].name, (int) (lowest + cell % difficulties),
+               percentile(seconds, 0.1), percentile(seconds, 0.5), percentile(seconds, 0.9),
+               percentile(scores, 0.1), percentile(scores, 0.5), percentile(scores, 0.9),
+               levels / games, 100.0 * finished / games);
+    }
+    printf("\n%zu games on %u threads in %.2f s: %.0f games per second, %.3g game seconds per second\n",
+           outcomes.size(), pool.size(), elapsed, outcomes.size() / elapsed, ticks * TICK_MS / 1000.0 / elapsed);
+    return 0;
+}
@@ -0,0 +1,170 @@
+/*A small work-stealing thread pool for the host tools.
+
+run(count, job) calls job(i) once for every i from 0 to count-1, spread
+over one thread per core, and returns when they have all finished. Each
+thread starts with an equal slice of the indices and takes them from the
+front of its own slice one at a time. A thread that runs out steals the
+back half of the biggest slice left, so a few long jobs (a long game, a
+deep search) do not leave the other cores idle at the end.*/
+
+#ifndef HOST_THREADPOOL_H
+#define HOST_THREADPOOL_H
+
+#include <stddef.h>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkPool {
+public:
+    /*Starts threads worker threads, or one per core if threads is 0.*/
+    explicit WorkPool(unsigned threads = 0) : job(0), generation(0), busy(0), steals(0), stopping(false) {
+        if (threads == 0) {
+            threads = std::thread::hardware_concurrency();
+        }
+        if (threads == 0) {
+            threads = 1;
+        }
+        slices = std::vector<Slice>(threads);
+        for (unsigned k = 0; k < threads; ++k) {
+            workers.push_back(std::thread(&WorkPool::worker, this, k));
+        }
+    }
+
+    ~WorkPool() {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (size_t k = 0; k < workers.size(); ++k) {
+            workers[k].join();
+        }
+    }
+
+    unsigned size() const {
+        return workers.size();
+    }
+
+    /*How many times a thread has taken work from another, over all runs.*/
+    unsigned long stealCount() const {
+        return steals;
+    }
+
+    /*Runs job(0) to job(count-1) on the pool and waits for all of them.*/
+    void run(size_t count, const std::function<void(size_t)>& job) {
+        size_t n = slices.size();
+        for (size_t k = 0; k < n; ++k) {
+            slices[k].begin = count * k / n;
+            slices[k].end = count * (k + 1) / n;
+        }
+        std::unique_lock<std::mutex> guard(lock);
+        this->job = &job;
+        busy = n;
+        ++generation;
+        wake.notify_all();
+        done.wait(guard, [this] { return busy == 0; });
+        this->job = 0;
+    }
+
+private:
+    // the indices [begin, end) still to be run by one thread
+    struct Slice {
+        std::mutex lock;
+        size_t begin;
+        size_t end;
+
+        Slice() : begin(0), end(0) {}
+        Slice(const Slice&) : begin(0), end(0) {} // only so the vector can be sized
+    };
+
+    /*Takes the next index from the front of slice k.*/
+    bool take(size_t k, size_t* index) {
+        std::lock_guard<std::mutex> guard(slices[k].lock);
+        if (slices[k].begin >= slices[k].end) {
+            return false;
+        }
+        *index = slices[k].begin++;
+        return true;
+    }
+
+    /*Moves the back half of the biggest other slice into slice k, which is
+    empty. Returns false when there is nothing left anywhere.*/
+    bool steal(size_t k) {
+        while (true) {
+            size_t victim = k;
+            size_t most = 0;
+            for (size_t j = 0; j < slices.size(); ++j) {
+                if (j != k) {
+                    std::lock_guard<std::mutex> guard(slices[j].lock);
+                    if (slices[j].end - slices[j].begin > most) {
+                        most = slices[j].end - slices[j].begin;
+                        victim = j;
+                    }
+                }
+            }
+            if (most == 0) {
+                return false;
+            }
+            size_t begin, end;
+            {
+                std::lock_guard<std::mutex> guard(slices[victim].lock);
+                size_t left = slices[victim].end - slices[victim].begin;
+                if (left == 0) {
+                    continue; // someone else got there first, look again
+                }
+                end = slices[victim].end;
+                begin = end - (left + 1) / 2;
+                slices[victim].end = begin;
+            }
+            std::lock_guard<std::mutex> guard(slices[k].lock);
+            slices[k].begin = begin;
+            slices[k].end = end;
+            ++steals;
+            return true;
+        }
+    }
+
+    void worker(size_t k) {
+        unsigned long seen = 0;
+        while (true) {
+            const std::function<void(size_t)>* current;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [this, seen] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+                current = job;
+            }
+            size_t index;
+            do {
+                while (take(k, &index)) {
+                    (*current)(index);
+                }
+            } while (steal(k));
+
+            std::lock_guard<std::mutex> guard(lock);
+            if (--busy == 0) {
+                done.notify_all();
+            }
+        }
+    }
+
+    std::vector<Slice> slices;
+    std::vector<std::thread> workers;
+    std::mutex lock; // guards everything below but steals
+    std::condition_variable wake;
+    std::condition_variable done;
+    const std::function<void(size_t)>* job;
+    unsigned long generation; // counts the calls to run
+    size_t busy; // threads still working on this run
+    std::atomic<unsigned long> steals;
+    bool stopping;
+};
+
+#endif
@@ -0,0 +1,104 @@
+/*A fixed-size transposition table for the searches on the host: values
+of positions already searched, keyed by their 64 bit Zobrist hash (see
+zobristBoard() in engine.cpp), so a position reached again costs a probe
+instead of running every cascade below it a second time.
+
+Many threads read and write it at once without locks. Each entry is
+three words: the key XORed with the other two, the value and a word with
+the depth and age. A thread that reads an entry while another is halfway
+through writing it sees a key that does not match and treats it as a
+miss, so a torn entry is never used (Hyatt and Mann's lockless hashing).
+
+Every bucket holds two entries. The first keeps the deepest search of
+the positions that land in the bucket, unless it is left over from an
+earlier decision; the second always takes the newest one.*/
+
+#ifndef HOST_TTABLE_H
+#define HOST_TTABLE_H
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+class TransTable {
+public:
+    /*A table of about megabytes MB.*/
+    explicit TransTable(size_t megabytes) : buckets(1), age(0) {
+        size_t wanted = megabytes * 1024 * 1024 / sizeof(Bucket);
+        while (buckets * 2 <= wanted) {
+            buckets *= 2;
+        }
+        table = std::vector<Bucket>(buckets);
+        clear();
+    }
+
+    /*Forgets every position, e.g. for a new game with other rules.*/
+    void clear() {
+        for (size_t b = 0; b < buckets; ++b) {
+            for (int k = 0; k < 2; ++k) {
+                table[b].entries[k].check.store(0, std::memory_order_relaxed);
+                table[b].entries[k].value.store(0, std::memory_order_relaxed);
+                table[b].entries[k].meta.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /*Starts a new decision: entries from earlier ones may be replaced
+    even by shallower searches.*/
+    void newAge() {
+        age = (age + 1) & 0xFF;
+    }
+
+    /*Looks up the value of a position searched to exactly depth.*/
+    bool probe(uint64_t key, int depth, double* value) {
+        Bucket& bucket = table[key & (buckets - 1)];
+        for (int k = 0; k < 2; ++k) {
+            uint64_t bits = bucket.entries[k].value.load(std::memory_order_relaxed);
+            uint64_t meta = bucket.entries[k].meta.load(std::memory_order_relaxed);
+            uint64_t check = bucket.entries[k].check.load(std::memory_order_relaxed);
+            if ((check ^ bits ^ meta) == key && (int) (meta & 0xFF) == depth) {
+                memcpy(value, &bits, sizeof(bits));
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void store(uint64_t key, int depth, double value) {
+        Bucket& bucket = table[key & (buckets - 1)];
+        uint64_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        uint64_t meta = (uint64_t) age << 8 | (depth & 0xFF);
+        uint64_t old = bucket.entries[0].meta.load(std::memory_order_relaxed);
+        bool empty = bucket.entries[0].check.load(std::memory_order_relaxed) == 0 && old == 0;
+        int k = (empty || depth >= (int) (old & 0xFF) || (old >> 8) != age) ? 0 : 1;
+        bucket.entries[k].check.store(key ^ bits ^ meta, std::memory_order_relaxed);
+        bucket.entries[k].value.store(bits, std::memory_order_relaxed);
+        bucket.entries[k].meta.store(meta, std::memory_order_relaxed);
+    }
+
+    size_t sizeBytes() const {
+        return buckets * sizeof(Bucket);
+    }
+
+private:
+    struct Entry {
+        std::atomic<uint64_t> check; // key ^ value ^ meta
+        std::atomic<uint64_t> value; // the bits of a double
+        std::atomic<uint64_t> meta; // age << 8 | depth
+    };
+
+    struct Bucket {
+        Entry entries[2];
+
+        Bucket() {}
+        Bucket(const Bucket&) {} // only so the vector can be sized, clear() fills them in
+    };
+
+    std::vector<Bucket> table;
+    size_t buckets; // a power of 2
+    unsigned age;
+};
+
+#endif
@@ -0,0 +1,151 @@
+/*Checks a whole archive of game logs at once: every log is loaded into
+memory, then replayed headless on all cores (see threadpool.h), and
+the final score, level and board hash of each game are compared with
+the ones recorded at the end of its log. Run it after any change to the
+rules to find the games that no longer end the same way.
+
+Prints one line per log (only the ones that do not match with -q), then
+how many replays and ticks were run per second. With "-s ticks" every
+game is also saved to a snapshot (see snapshot.h) and carried on from it
+that often, so the games only end the same if the snapshots lose nothing.
+
+Usage: verify [-j threads] [-q] [-s ticks] (log | directory)...*/
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "gamelog.h"
+#include "snapshot.h"
+#include "host/logfile.h"
+#include "host/threadpool.h"
+
+static const char* resultNames[] = {"matched", "DIVERGED", "truncated", "not a game log"};
+
+struct Check {
+    std::string path;
+    LogBuffer log;
+    int result;
+    uint32_t ticks;
+    int32_t score;
+    int16_t level;
+    uint32_t hash;
+};
+
+/*Adds path to paths, or every file in it if it is a directory.*/
+static void addPath(const std::string& path, std::vector<std::string>* paths) {
+    struct stat info;
+    if (stat(path.c_str(), &info) != 0 || !S_ISDIR(info.st_mode)) {
+        paths->push_back(path);
+        return;
+    }
+    DIR* dir = opendir(path.c_str());
+    if (dir == 0) {
+        perror(path.c_str());
+        return;
+    }
+    std::vector<std::string> names;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != 0) {
+        if (entry->d_name[0] != '.') {
+            names.push_back(path + "/" + entry->d_name);
+        }
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    paths->insert(paths->end(), names.begin(), names.end());
+}
+
+static void replayCheck(Check* check, uint32_t snapshotTicks) {
+    Session session;
+    memset(&session, 0, sizeof(session)); // what is reported if the log is not a game log
+    Replay replay;
+    if (!replayBegin(&replay, readLogBuffer, &check->log, &session)) {
+        check->result = ReplayBadLog;
+    }
+    else {
+        check->result = -1;
+        while (replayTick(&replay, &session)) {
+            if (snapshotTicks > 0 && session.tick % snapshotTicks == 0 && session.phase != Over) {
+                uint8_t bytes[SNAPSHOT_SIZE];
+                uint32_t seed;
+                uint16_t sequence;
+                saveSnapshot(&session, 0, 0, bytes);
+                if (!loadSnapshot(bytes, &session, &seed, &sequence)) {
+                    check->result = ReplayDiverged;
+                    break;
+                }
+            }
+        }
+        if (check->result < 0) {
+            check->result = replayFinish(&replay, &session);
+        }
+    }
+    check->ticks = session.tick;
+    check->score = session.game.score;
+    check->level = session.game.level;
+    check->hash = boardHash(&session.game);
+}
+
+int main(int argc, char** argv) {
+    unsigned threads = 0;
+    bool quiet = false;
+    uint32_t snapshotTicks = 0;
+    std::vector<std::string> paths;
+    for (int k = 1; k < argc; ++k) {
+        if (strcmp(argv[k], "-j") == 0 && k + 1 < argc) {
+            threads = atoi(argv[++k]);
+        }
+        else if (strcmp(argv[k], "-q") == 0) {
+            quiet = true;
+        }
+        else if (strcmp(argv[k], "-s") == 0 && k + 1 < argc) {
+            snapshotTicks = atoi(argv[++k]);
+        }
+        else {
+            addPath(argv[k], &paths);
+        }
+    }
+    if (paths.empty()) {
+        fprintf(stderr, "usage: verify [-j threads] [-q] [-s ticks] (log | directory)...\n");
+        return 2;
+    }
+
+    std::vector<Check> checks(paths.size());
+    for (size_t n = 0; n < paths.size(); ++n) {
+        checks[n].path = paths[n];
+        if (!loadLog(paths[n].c_str(), &checks[n].log)) {
+            perror(paths[n].c_str());
+            return 2;
+        }
+    }
+
+    WorkPool pool(threads);
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    pool.run(checks.size(), [&](size_t n) { replayCheck(&checks[n], snapshotTicks); });
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    int counts[4] = {0, 0, 0, 0};
+    long long ticks = 0;
+    for (size_t n = 0; n < checks.size(); ++n) {
+        const Check& c = checks[n];
+        ++counts[c.result];
+        ticks += c.ticks;
+        if (!quiet || c.result != ReplayMatched) {
+            printf("%s: %s, score %d, level %d, board hash %08x\n", c.path.c_str(), resultNames[c.result],
+                   c.score, c.level, c.hash);
+        }
+    }
+    printf("%zu logs: %d matched, %d diverged, %d truncated, %d not game logs\n", checks.size(),
+           counts[ReplayMatched], counts[ReplayDiverged], counts[ReplayTruncated], counts[ReplayBadLog]);
+    printf("%u threads, %.3f s, %.0f replays per second, %.0f ticks per second, %lu steals\n", pool.size(),
+           elapsed, checks.size() / elapsed, ticks / elapsed, pool.stealCount());
+    return counts[ReplayMatched] == (int) checks.size() ? 0 : 1;
+}
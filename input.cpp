@@ -0,0 +1,177 @@
+#include "input.h"
+
+#ifdef __AVR__
+#include <Arduino.h>
+#include <avr/interrupt.h>
+#endif
+
+// both input interrupts push (they cannot interrupt each other), the game pops
+static InputEvent events[INPUT_QUEUE_SIZE];
+static volatile uint8_t head = 0; // written only by the producer (the interrupts)
+static volatile uint8_t tail = 0; // written only by the consumer (the game)
+static volatile uint8_t dropped = 0; // events lost because the queue was full
+
+/*Empties the queue.*/
+void inputReset() {
+    head = 0;
+    tail = 0;
+    dropped = 0;
+}
+
+/*Adds an event to the queue. Returns false (and counts the event as
+dropped) if the queue is full.*/
+bool inputPush(uint8_t type, int8_t value, uint32_t time) {
+    uint8_t h = head;
+    if ((uint8_t) (h - tail) >= INPUT_QUEUE_SIZE) {
+        ++dropped;
+        return false;
+    }
+    InputEvent* event = &events[h & (INPUT_QUEUE_SIZE - 1)];
+    event->type = type;
+    event->value = value;
+    event->time = time;
+    head = h + 1; // publish the event only once it is complete
+    return true;
+}
+
+/*Takes the oldest event off the queue. Returns false if there is none.*/
+bool inputPop(InputEvent* event) {
+    uint8_t t = tail;
+    if (t == head) {
+        return false;
+    }
+    *event = events[t & (INPUT_QUEUE_SIZE - 1)];
+    tail = t + 1; // only now can the interrupt reuse the slot
+    return true;
+}
+
+/*The number of events lost because the game did not take them off the
+queue quickly enough.*/
+uint8_t inputDropped() {
+    return dropped;
+}
+
+#ifdef __AVR__
+
+// a button is reported as soon as it changes, and then ignored for
+// DEBOUNCE_MS so its contacts can settle
+struct Button {
+    volatile uint8_t* port;
+    uint8_t mask;
+    uint8_t type;
+    bool pressed; // what was last reported
+    uint32_t changed; // when it was last reported
+};
+
+static Button colourButton;
+static Button selectButton;
+
+// the ADC converts these channels one after the other
+static uint8_t channels[2] = {JOY_VERT_ANALOG, JOY_HORIZ_ANALOG};
+static uint8_t channel = 0; // the one being converted
+static int vCentre;
+static int hCentre;
+static int8_t joyV = 0; // the last reported direction of each axis
+static int8_t joyH = 0;
+
+/*The time stamped on the events.*/
+static uint32_t inputClock() {
+#ifdef LATENCY
+    return micros();
+#else
+    return millis();
+#endif
+}
+
+static void setupButton(Button* button, int pin, uint8_t type) {
+    button->port = portInputRegister(digitalPinToPort(pin));
+    button->mask = digitalPinToBitMask(pin);
+    button->type = type;
+    button->pressed = false;
+    button->changed = 0;
+}
+
+/*Reports a change of a button if it is not a bounce. Interrupts must be off.*/
+static void readButton(Button* button, uint32_t now) {
+    bool pressed = (*button->port & button->mask) == 0; // the buttons pull the pin low
+    if (pressed != button->pressed && now - button->changed >= DEBOUNCE_MS * INPUT_CLOCK_PER_MS) {
+        button->pressed = pressed;
+        button->changed = now;
+        inputPush(button->type, pressed, now);
+    }
+}
+
+/*Turns an axis reading into a direction, reporting it when it changes.
+Leaving a direction needs the reading to come JOY_HYSTERESIS back inside
+the deadzone, so a reading on the edge does not flicker.*/
+static void readAxis(int delta, int8_t* direction, uint8_t type, uint32_t now) {
+    int8_t d = *direction;
+    if (delta > JOY_DEADZONE) {
+        d = 1;
+    }
+    else if (delta < -JOY_DEADZONE) {
+        d = -1;
+    }
+    else if (abs(delta) < JOY_DEADZONE - JOY_HYSTERESIS) {
+        d = 0;
+    }
+    if (d != *direction) {
+        *direction = d;
+        inputPush(type, d, now);
+    }
+}
+
+/*Selects the channel the next conversion reads. A conversion is started
+by every overflow of Timer0 (the one millis() runs on), every 1024 us,
+so each axis is read about 490 times a second; changing channels in
+between is safe, the ADC is idle.*/
+static void selectChannel() {
+    ADMUX = (1 << REFS0) | (channels[channel] & 0x07); // AVcc reference, as analogRead uses
+    ADCSRB = (1 << ADTS2) | ((channels[channel] & 0x08) ? (1 << MUX5) : 0); // triggered by Timer0 overflow
+}
+
+/*The colour button changed: report it straight away.*/
+static void colourEdge() {
+    readButton(&colourButton, inputClock());
+}
+
+/*Starts capturing input. colourPin is the colour button (it must have an
+external interrupt), vCentre and hCentre are the resting readings of
+the joystick. analogRead must not be used after this.*/
+void inputBegin(int colourPin, int vCentreReading, int hCentreReading) {
+    vCentre = vCentreReading;
+    hCentre = hCentreReading;
+    inputReset();
+
+    uint8_t oldSREG = SREG;
+    cli();
+    setupButton(&colourButton, colourPin, InputColour);
+    setupButton(&selectButton, JOY_SEL, InputSelect);
+    attachInterrupt(digitalPinToInterrupt(colourPin), colourEdge, CHANGE);
+    channel = 0;
+    selectChannel();
+    ADCSRA = (1 << ADEN) | (1 << ADATE) | (1 << ADIE) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+    SREG = oldSREG;
+}
+
+/*A conversion has finished, about once a millisecond: report the axis
+it was for and the buttons, then select the other channel for the next.*/
+ISR(ADC_vect) {
+    int reading = ADC;
+    uint32_t now = inputClock();
+    if (channel == 0) {
+        readAxis(reading - vCentre, &joyV, InputJoyV, now);
+    }
+    else {
+        readAxis(reading - hCentre, &joyH, InputJoyH, now);
+    }
+    // the joystick button has no pin change interrupt, so it is read here,
+    // and the colour button too in case its last edge was taken for a bounce
+    readButton(&selectButton, now);
+    readButton(&colourButton, now);
+
+    channel = !channel;
+    selectChannel();
+}
+
+#endif
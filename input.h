@@ -0,0 +1,50 @@
+/*Button and joystick input captured by interrupts. The colour button
+interrupts on every edge, and the ADC converts the joystick axes one
+after the other in the background, one conversion every millisecond
+started by Timer0, with the joystick button (which has no pin change
+interrupt on the Mega) read at the end of every conversion. Each
+debounced press, release or change of joystick direction is put into a
+small queue with the time it happened, and the game takes the events
+off the queue whenever it gets round to it, so short presses are never
+missed and the game loop does not read any pins.*/
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+
+#define JOY_SEL 9 //the joystick button pin
+#define JOY_VERT_ANALOG 0 // pins connected to vertical and horizontal joystick
+#define JOY_HORIZ_ANALOG 1
+
+#define JOY_DEADZONE 64 //the deadzone of the joystick
+#define JOY_HYSTERESIS 16 // the joystick has to come this far back inside the deadzone to centre again
+#define DEBOUNCE_MS 10 // changes of a button this soon after the last one are bounces
+#ifdef LATENCY
+#define INPUT_CLOCK_PER_MS 1000UL
+#else
+#define INPUT_CLOCK_PER_MS 1UL
+#endif
+
+#define INPUT_QUEUE_SIZE 16 // must be a power of 2
+
+// buttons: value 1 = pressed, 0 = released
+// joystick: value -1 = left/up, 0 = centred, 1 = right/down
+enum InputType {InputColour, InputSelect, InputJoyH, InputJoyV};
+
+struct InputEvent {
+    uint8_t type;
+    int8_t value;
+    uint32_t time; // millis() when it happened, micros() when the latency is measured (see latency.h)
+};
+
+void inputReset();
+bool inputPush(uint8_t type, int8_t value, uint32_t time);
+bool inputPop(InputEvent* event);
+uint8_t inputDropped();
+
+#ifdef __AVR__
+void inputBegin(int colourPin, int vCentre, int hCentre);
+#endif
+
+#endif
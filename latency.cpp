@@ -0,0 +1,108 @@
+#include "latency.h"
+
+// the Arduino only keeps the times when it measures them
+#if defined(LATENCY) || !defined(__AVR__)
+#include <string.h>
+
+#include "spiqueue.h"
+
+#ifdef __AVR__
+#include <Arduino.h>
+#endif
+
+LatencyStats latencyStats[NUM_LATENCY_KINDS];
+
+// inputs acted on since the last frame, with when they happened
+static uint8_t pendingKinds = 0;
+static uint32_t pendingTime[NUM_LATENCY_KINDS];
+
+// inputs whose frame is being sent: the game writes sentSeq and the
+// marker hook shownSeq, so a kind is on its way while they differ
+static uint32_t flightTime[NUM_LATENCY_KINDS];
+static uint8_t sentSeq[NUM_LATENCY_KINDS];
+static volatile uint8_t shownSeq[NUM_LATENCY_KINDS];
+
+/*Forgets every time measured so far.*/
+void latencyReset() {
+    memset(latencyStats, 0, sizeof(latencyStats));
+    pendingKinds = 0;
+    for (int k = 0; k < NUM_LATENCY_KINDS; ++k) {
+        shownSeq[k] = sentSeq[k];
+    }
+}
+
+/*The game has acted on an input of a kind that happened at time (in us).*/
+void latencyInput(uint8_t kind, uint32_t time) {
+    if (!(pendingKinds & (1 << kind))) {
+        pendingKinds |= 1 << kind;
+        pendingTime[kind] = time;
+    }
+}
+
+/*The frame showing the inputs acted on so far has been sent: sends the
+marker that times them. A kind whose last frame has not gone out
+yet waits for the next one.*/
+void latencyFrame() {
+    uint8_t kinds = 0;
+    for (int k = 0; k < NUM_LATENCY_KINDS; ++k) {
+        if ((pendingKinds & (1 << k)) && sentSeq[k] == shownSeq[k]) {
+            flightTime[k] = pendingTime[k];
+            ++sentSeq[k];
+            kinds |= 1 << k;
+        }
+    }
+    if (kinds != 0) {
+        pendingKinds &= ~kinds;
+        displayMarker(kinds);
+    }
+}
+
+/*The frame for the inputs of the given kinds (one bit each) finished
+going out at time (in us). Called by the marker hook.*/
+void latencyShown(uint8_t kinds, uint32_t time) {
+    for (int k = 0; k < NUM_LATENCY_KINDS; ++k) {
+        if (!(kinds & (1 << k))) {
+            continue;
+        }
+        uint32_t latency = time - flightTime[k];
+        LatencyStats* stats = &latencyStats[k];
+        uint32_t bucket = latency / LATENCY_BUCKET_US;
+        ++stats->buckets[bucket < LATENCY_BUCKETS ? bucket : LATENCY_BUCKETS - 1];
+        ++stats->count;
+        if (latency > stats->max) {
+            stats->max = latency;
+        }
+        shownSeq[k] = sentSeq[k];
+    }
+}
+
+/*The time (in us) that percent of the inputs of a kind took at most,
+rounded up to the end of its bucket and never more than the slowest.*/
+uint32_t latencyPercentile(uint8_t kind, int percent) {
+    const LatencyStats* stats = &latencyStats[kind];
+    uint32_t wanted = ((uint32_t) stats->count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int b = 0; b < LATENCY_BUCKETS; ++b) {
+        seen += stats->buckets[b];
+        if (seen >= wanted && seen > 0) {
+            uint32_t end = (uint32_t) (b + 1) * LATENCY_BUCKET_US;
+            return end < stats->max ? end : stats->max;
+        }
+    }
+    return stats->max;
+}
+
+#ifdef LATENCY
+/*The frame before a marker has been sent.*/
+static void markerReached(uint8_t kinds) {
+    latencyShown(kinds, micros());
+}
+
+/*Starts timing the frames. Call after displayBegin().*/
+void latencyBegin() {
+    latencyReset();
+    displaySetMarkerHook(markerReached);
+}
+#endif
+
+#endif
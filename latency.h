@@ -0,0 +1,54 @@
+/*Measures how long an input takes to reach the screen: from the moment
+the input interrupt saw the joystick or a button change to the moment
+the last byte of the first frame drawn after the game acted on it has
+gone out over SPI. "make upload LATENCY=1" measures it on the Arduino
+(the input events are then timed with micros() instead of millis()) and
+prints it on the serial port at game over; build-host/latbench measures
+it on the host with simulated input and a model of the SPI bus.
+
+The game calls latencyInput() when it acts on an input and
+latencyFrame() once it has sent the frame that shows it. That sends a
+marker after the frame, and the marker hook calls latencyShown() with
+the time once the bytes before it are out. An input
+that changes nothing on the screen (a move into a full column) is still
+timed to the end of the next frame. Only the first input of each kind
+between two frames is timed.
+
+For each kind the times are kept in 1 ms buckets, so the percentiles
+are rounded up to the next whole millisecond.*/
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+#define LATENCY_BUCKETS 64 // the last one also holds everything slower
+#define LATENCY_BUCKET_US 1000
+
+// the first three are in the order of SessionInput
+enum LatencyKind {LatencyMove, LatencyDrop, LatencyRotate, LatencyPause, NUM_LATENCY_KINDS};
+
+struct LatencyStats {
+    uint16_t count;
+    uint32_t max; // in us
+    uint16_t buckets[LATENCY_BUCKETS];
+};
+
+extern LatencyStats latencyStats[NUM_LATENCY_KINDS];
+
+void latencyReset();
+void latencyInput(uint8_t kind, uint32_t time);
+void latencyFrame();
+void latencyShown(uint8_t kinds, uint32_t time);
+uint32_t latencyPercentile(uint8_t kind, int percent);
+
+#ifdef LATENCY
+void latencyBegin();
+#define LATENCY_INPUT(kind, time) latencyInput(kind, time)
+#define LATENCY_FRAME() latencyFrame()
+#else
+#define LATENCY_INPUT(kind, time)
+#define LATENCY_FRAME()
+#endif
+
+#endif
@@ -0,0 +1,239 @@
+#include <Arduino.h>
+#include <Adafruit_ST7735.h>
+
+#include "display.h"
+#include "playfield.h"
+#include "blit.h"
+#include "spiqueue.h"
+
+/*The playfield is split into strips, one per column of the grid: strip s
+covers x = 10s to 10s+9, and a last strip covers the single pixel column
+x = 60 that holds the right border of the last column. Within a strip
+every pixel row looks the same from x+1 to x+9 (black, white border or
+one block colour) and only the left pixel can differ (it is the white
+border shared with the column to the left). So one byte per strip and
+pixel row is enough to describe the whole playfield:
+
+  bits 0-2: what the 9 inner pixels show, 0 = background, 1-6 = a Shade,
+            CODE_BORDER = white border
+  bit 3:    the left pixel is white
+
+sent[][] holds the codes of what is on the screen right now. Anything
+that changes marks a range of rows in the strips it touches as dirty,
+and drawPlayfield() recomputes only those rows from the grid and the
+falling stack, then pushes each run of rows that differ in a single
+address window.*/
+
+#define NUM_STRIPS (NUM_COLS + 1)
+#define CODE_BORDER 7
+#define CODE_LEFT_WHITE 8
+
+static uint8_t sent[NUM_STRIPS][PLAYFIELD_HEIGHT];
+
+// the rows of each strip that may have changed, clean when top > bottom
+static uint8_t dirtyTop[NUM_STRIPS];
+static uint8_t dirtyBottom[NUM_STRIPS];
+
+// the falling stack, drawn on top of the grid
+static bool stackShown = false;
+static int stackX;
+static int stackY;
+static Shade stackColours[3];
+
+/*Marks rows top to bottom of a strip as needing to be recomputed.*/
+static void invalidateRows(int strip, int top, int bottom) {
+    if (strip < 0 || strip >= NUM_STRIPS) {
+        return;
+    }
+    top = constrain(top, 0, PLAYFIELD_HEIGHT - 1);
+    bottom = constrain(bottom, 0, PLAYFIELD_HEIGHT - 1);
+    if (top > bottom) {
+        return;
+    }
+    if (dirtyTop[strip] > dirtyBottom[strip]) {
+        dirtyTop[strip] = top;
+        dirtyBottom[strip] = bottom;
+    }
+    else {
+        if (top < dirtyTop[strip]) {
+            dirtyTop[strip] = top;
+        }
+        if (bottom > dirtyBottom[strip]) {
+            dirtyBottom[strip] = bottom;
+        }
+    }
+}
+
+/*Marks the area of the falling stack (both borders included) as dirty.*/
+static void invalidateStack() {
+    if (stackShown) {
+        int strip = stackX / BLOCK_STEP;
+        int top = stackY - 2*BLOCK_STEP;
+        int bottom = stackY + BLOCK_STEP;
+        invalidateRows(strip, top, bottom);
+        invalidateRows(strip + 1, top, bottom);
+    }
+}
+
+/*Forgets what is on the screen and assumes the playfield is all black,
+as it is right after displayGame() has drawn the game screen.*/
+void resetPlayfield() {
+    memset(sent, 0, sizeof(sent));
+    for (int s = 0; s < NUM_STRIPS; ++s) {
+        dirtyTop[s] = 1;
+        dirtyBottom[s] = 0;
+    }
+    stackShown = false;
+}
+
+/*Moves the falling stack to a new pixel location (the top left corner
+of its bottom block) and/or changes its colours.*/
+void setFallingStack(int x, int y, Shade Bcolour, Shade Mcolour, Shade Tcolour) {
+    invalidateStack(); // the old location
+    stackShown = true;
+    stackX = x;
+    stackY = y;
+    stackColours[0] = Bcolour;
+    stackColours[1] = Mcolour;
+    stackColours[2] = Tcolour;
+    invalidateStack(); // the new location
+}
+
+/*Removes the falling stack, e.g. once it has landed and become part of the grid.*/
+void hideFallingStack() {
+    invalidateStack();
+    stackShown = false;
+}
+
+/*Marks a block of the grid as changed so it is redrawn on the next drawPlayfield().*/
+void invalidateBlock(int col, int row) {
+    int top = SCREEN_SIZE_Y - BLOCK_HEIGHT - BLOCK_STEP*row;
+    invalidateRows(col, top, top + BLOCK_HEIGHT - 1);
+    invalidateRows(col + 1, top, top + BLOCK_HEIGHT - 1); // its right border
+}
+
+/*What a column of the grid shows at pixel row y: 0 for nothing,
+a Shade for the inside of a block or CODE_BORDER for a border.*/
+static uint8_t gridCover(const Game* game, int col, int y) {
+    int d = SCREEN_SIZE_Y - 1 - y; // distance from the bottom of the screen
+    if (y < GRID_TOP) {
+        return 0;
+    }
+    int row = d / BLOCK_STEP;
+    if (d % BLOCK_STEP == 0) {
+        // the bottom border of this row and the top border of the one below
+        if ((row < NUM_ROWS && blockAt(game, col, row) != Black) || (row > 0 && blockAt(game, col, row-1) != Black)) {
+            return CODE_BORDER;
+        }
+        return 0;
+    }
+    return blockAt(game, col, row);
+}
+
+/*What the falling stack shows in a column at pixel row y.*/
+static uint8_t stackCover(int col, int y) {
+    if (!stackShown || col != stackX / BLOCK_STEP) {
+        return 0;
+    }
+    int d = stackY + BLOCK_STEP - y; // distance from the bottom border of the stack
+    if (d < 0 || d > 3*BLOCK_STEP) {
+        return 0;
+    }
+    if (d % BLOCK_STEP == 0) {
+        return CODE_BORDER;
+    }
+    return stackColours[d / BLOCK_STEP];
+}
+
+/*What a column shows at pixel row y, with the inside of a block taking
+priority over a border.*/
+static uint8_t cover(const Game* game, int col, int y) {
+    uint8_t grid = gridCover(game, col, y);
+    uint8_t stack = stackCover(col, y);
+    if (grid == 0 || (grid == CODE_BORDER && stack != 0)) {
+        return stack;
+    }
+    return grid;
+}
+
+/*Works out the code of one strip at pixel row y (see the top of this file).*/
+static uint8_t stripCode(const Game* game, int strip, int y) {
+    uint8_t here = strip < NUM_COLS ? cover(game, strip, y) : 0;
+    uint8_t left = strip > 0 ? cover(game, strip - 1, y) : 0;
+    if (here != 0 || left != 0) {
+        return here | CODE_LEFT_WHITE;
+    }
+    return here;
+}
+
+/*The palette index of the background behind the grid. The pixel column
+at x = 60 is part of the red bar at the top of the screen.*/
+static uint8_t background(int strip, int y) {
+    if (strip == NUM_COLS && y < GRID_TOP) {
+        return PALETTE_RED;
+    }
+    return Black;
+}
+
+/*The palette indices of the left pixel and of the inside of a row.*/
+static void rowColours(int strip, int y, uint8_t* left, uint8_t* inside) {
+    uint8_t code = sent[strip][y];
+    *inside = code & CODE_BORDER; // CODE_BORDER is also the index of white
+    if (*inside == 0) {
+        *inside = background(strip, y);
+    }
+    *left = code & CODE_LEFT_WHITE ? PALETTE_WHITE : background(strip, y);
+}
+
+/*Sends rows top to bottom of one strip to the screen in one address window
+and one SPI burst. Neighbouring rows that look the same go out as one command.*/
+static void pushRows(int strip, int top, int bottom) {
+    int x = strip * BLOCK_STEP;
+    int width = strip < NUM_COLS ? BLOCK_STEP : 1;
+    blitBegin(x, top, x + width - 1, bottom);
+    int y = top;
+    while (y <= bottom) {
+        uint8_t left, inside;
+        rowColours(strip, y, &left, &inside);
+        int rows = 1;
+        while (y + rows <= bottom) {
+            uint8_t nextLeft, nextInside;
+            rowColours(strip, y + rows, &nextLeft, &nextInside);
+            if (nextLeft != left || nextInside != inside) {
+                break;
+            }
+            ++rows;
+        }
+        blitRows(left, inside, PALETTE_NONE, width - 1, rows);
+        y += rows;
+    }
+    blitEnd();
+}
+
+/*Brings the screen up to date with the grid and the falling stack,
+sending only the rows of each strip that have actually changed.*/
+void drawPlayfield(const Game* game) {
+    for (int s = 0; s < NUM_STRIPS; ++s) {
+        int top = dirtyTop[s];
+        int bottom = dirtyBottom[s];
+        int runStart = -1;
+        for (int y = top; y <= bottom; ++y) {
+            uint8_t code = stripCode(game, s, y);
+            if (code != sent[s][y]) {
+                sent[s][y] = code;
+                if (runStart < 0) {
+                    runStart = y;
+                }
+            }
+            else if (runStart >= 0) {
+                pushRows(s, runStart, y - 1);
+                runStart = -1;
+            }
+        }
+        if (runStart >= 0) {
+            pushRows(s, runStart, bottom);
+        }
+        dirtyTop[s] = 1;
+        dirtyBottom[s] = 0;
+    }
+}
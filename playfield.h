@@ -0,0 +1,21 @@
+/*A shadow model of the playfield (the 61x160 area on the left of the
+screen holding the grid and the falling stack). Instead of drawing and
+erasing blocks directly, the game says what has changed and
+drawPlayfield() works out which pixels are now different from what the
+screen shows and sends only those.*/
+
+#ifndef PLAYFIELD_H
+#define PLAYFIELD_H
+
+#include "engine.h"
+
+#define PLAYFIELD_WIDTH 61
+#define PLAYFIELD_HEIGHT 160
+
+void resetPlayfield();
+void setFallingStack(int x, int y, Shade Bcolour, Shade Mcolour, Shade Tcolour);
+void hideFallingStack();
+void invalidateBlock(int col, int row);
+void drawPlayfield(const Game* game);
+
+#endif
@@ -0,0 +1,129 @@
+#include "profile.h"
+
+#ifdef PROFILE
+#include <Arduino.h>
+#include <avr/interrupt.h>
+
+/*A window as it goes out, after the 4 header bytes. The AVR has no
+padding and is little endian, so this is byte for byte the frame layout
+in profile.h.*/
+struct ProfileWindow {
+    uint16_t number;
+    uint32_t endMs;
+    uint8_t phases;
+    PhaseStats phase[NUM_PHASES];
+    uint16_t check;
+};
+
+static ProfileWindow ring[PROFILE_RING];
+static uint8_t filling = 0; // the window the phases are being counted in
+static uint8_t closed = 0; // windows waiting to be sent, the oldest is going out
+static uint16_t sent = 0; // bytes of the oldest one sent so far
+static uint16_t windowNumber = 0;
+static uint32_t windowStart;
+
+static volatile uint16_t overflows = 0; // the high 16 bits of the cycle count
+
+static const uint8_t header[4] = {'M', 'C', 'P', PROFILE_VERSION};
+
+ISR(TIMER1_OVF_vect) {
+    ++overflows;
+}
+
+/*Clears the counters of a window.*/
+static void clearWindow(ProfileWindow* window) {
+    memset(window, 0, sizeof(*window));
+    for (int p = 0; p < NUM_PHASES; ++p) {
+        window->phase[p].min = 0xFFFFFFFF;
+    }
+}
+
+/*Starts Timer1 counting every cycle and opens the first window.*/
+void profileBegin() {
+    TCCR1A = 0;
+    TCCR1B = _BV(CS10); // no prescaler
+    TIMSK1 = _BV(TOIE1);
+    clearWindow(&ring[filling]);
+    windowStart = millis();
+}
+
+/*The number of cycles since profileBegin(), wrapping around every 268 s.*/
+uint32_t profileCycles() {
+    uint8_t oldSREG = SREG;
+    cli();
+    uint16_t low = TCNT1;
+    uint16_t high = overflows;
+    if ((TIFR1 & _BV(TOV1)) && low < 0x8000) { // it overflowed before TCNT1 was read
+        ++high;
+    }
+    SREG = oldSREG;
+    return ((uint32_t) high << 16) | low;
+}
+
+/*Counts a run of phase that started at cycle start and ends now.*/
+void profileRecord(uint8_t phase, uint32_t start) {
+    uint32_t cycles = profileCycles() - start;
+    PhaseStats* stats = &ring[filling].phase[phase];
+    if (stats->runs < 0xFFFF) {
+        ++stats->runs;
+    }
+    if (cycles < stats->min) {
+        stats->min = cycles;
+    }
+    if (cycles > stats->max) {
+        stats->max = cycles;
+    }
+    stats->total += cycles;
+    int bucket = cycles == 0 ? 0 : 31 - __builtin_clzl(cycles) - PROFILE_BUCKET_SHIFT;
+    bucket = constrain(bucket, 0, PROFILE_BUCKETS - 1);
+    if (stats->buckets[bucket] < 255) {
+        ++stats->buckets[bucket];
+    }
+}
+
+/*Finishes the window being filled and opens the next one. If every
+other window is still waiting to be sent, this one is dropped instead.*/
+static void closeWindow() {
+    ProfileWindow* window = &ring[filling];
+    window->number = windowNumber++;
+    if (closed == PROFILE_RING - 1) {
+        clearWindow(window);
+        return;
+    }
+    window->endMs = millis();
+    window->phases = NUM_PHASES;
+    // Fletcher-16 over the window, as the host checks it
+    const uint8_t* bytes = (const uint8_t*) window;
+    uint16_t a = 0, b = 0;
+    for (uint16_t i = 0; i < sizeof(*window) - 2; ++i) {
+        a = (a + bytes[i]) % 255;
+        b = (b + a) % 255;
+    }
+    window->check = (b << 8) | a;
+    ++closed;
+    filling = (filling + 1) % PROFILE_RING;
+    clearWindow(&ring[filling]);
+}
+
+/*Called from the main loop: closes the window every PROFILE_WINDOW_MS
+and sends as much of the closed ones as the serial port takes without
+waiting.*/
+void profilePoll() {
+    PROFILE_BEGIN(PhaseExport);
+    uint32_t now = millis();
+    if (now - windowStart >= PROFILE_WINDOW_MS) {
+        windowStart = now;
+        closeWindow();
+    }
+    while (closed > 0 && Serial.availableForWrite() > 0) {
+        const ProfileWindow* window = &ring[(filling + PROFILE_RING - closed) % PROFILE_RING];
+        Serial.write(sent < sizeof(header) ? header[sent] : ((const uint8_t*) window)[sent - sizeof(header)]);
+        if (++sent == sizeof(header) + sizeof(*window)) {
+            sent = 0;
+            --closed;
+        }
+    }
+    PROFILE_END(PhaseExport);
+}
+
+#endif
@@ -0,0 +1,83 @@
+/*A profiler for the phases of the game loop on the Arduino, built with
+"make upload PROFILE=1" (otherwise PROFILE_BEGIN and PROFILE_END
+compile to nothing). Timer1 counts every CPU cycle, and each phase is
+timed from PROFILE_BEGIN to PROFILE_END: the time includes any phase
+inside it, such as sending the grid inside drawing the tick, or the
+parts of a cascade step inside the tick. For every phase
+the profiler keeps how many times it ran, its shortest, longest and
+total time, and how many runs fell into each power of two of cycles.
+
+Each phase costs 84 bytes of RAM (a PhaseStats in every window of the
+ring), so with PROFILE=1 the ring of NUM_PHASES phases takes about
+1.2 KB of the Mega's 8 KB.
+
+Every PROFILE_WINDOW_MS these counters are closed into a small ring and
+the main loop streams the closed windows out of the serial port at
+PROFILE_BAUD, a few bytes at a time so it never waits for the port. If
+the port falls behind, the oldest window is dropped and the gap shows in
+the window numbers. build-host/profdump decodes a capture of the port.
+
+Frame layout (numbers are little endian):
+  'M' 'C' 'P' PROFILE_VERSION
+  window number (2 bytes), millis() when it closed (4 bytes), NUM_PHASES (1 byte)
+  for each phase: runs (2 bytes), min, max, total cycles (4 bytes each),
+                  PROFILE_BUCKETS run counts (1 byte each, stuck at 255)
+  Fletcher-16 checksum of everything after the version (2 bytes)
+Bucket b counts the runs of 2^(b + PROFILE_BUCKET_SHIFT) cycles or
+more, and the first and last buckets also count anything shorter or
+longer.*/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+#define PROFILE_VERSION 4
+#define PROFILE_BAUD 500000 // exact on a 16 MHz Mega
+#define PROFILE_WINDOW_MS 500
+#define PROFILE_RING 3 // windows kept, including the one being filled
+#define PROFILE_BUCKETS 14
+#define PROFILE_BUCKET_SHIFT 6 // the first bucket starts at 64 cycles (4 us)
+#define PROFILE_CPU_HZ 16000000L
+
+enum ProfilePhase {
+    PhaseLoop, // one pass of the main loop
+    PhaseInput, // acting on the queued input events
+    PhaseRules, // one tick of the session
+    PhaseDraw, // drawing what the tick changed
+    PhaseHud, // the level, score and level up banner
+    PhaseLog, // writing the game log
+    PhaseExport, // closing windows and sending them
+    PhaseMatch, // finding the sequences in a step of a cascade (markMatches)
+    PhaseClear, // removing them and scoring (removeMatches)
+    PhaseGravity, // letting the blocks above fall (compactBlocks)
+    PhasePlayfield, // sending the changed rows of the grid and the falling stack
+    PhasePreview, // drawing the next stack
+    PhaseSave, // one step of writing a snapshot to the SD card
+    NUM_PHASES
+};
+
+struct PhaseStats {
+    uint16_t runs;
+    uint32_t min;
+    uint32_t max;
+    uint32_t total;
+    uint8_t buckets[PROFILE_BUCKETS];
+};
+
+#define PROFILE_PHASE_SIZE (2 + 3*4 + PROFILE_BUCKETS) // a PhaseStats in a frame
+#define PROFILE_FRAME_SIZE (4 + 2 + 4 + 1 + NUM_PHASES*PROFILE_PHASE_SIZE + 2)
+
+#ifdef PROFILE
+void profileBegin();
+uint32_t profileCycles();
+void profileRecord(uint8_t phase, uint32_t start);
+void profilePoll();
+#define PROFILE_BEGIN(phase) uint32_t profileStart##phase = profileCycles()
+#define PROFILE_END(phase) profileRecord(phase, profileStart##phase)
+#else
+#define PROFILE_BEGIN(phase)
+#define PROFILE_END(phase)
+#endif
+
+#endif
@@ -0,0 +1,187 @@
+#include <Arduino.h>
+#include <Adafruit_ST7735.h>
+
+#include "display.h"
+#include "playfield.h"
+#include "blit.h"
+#include "profile.h"
+#include "render.h"
+
+// the RGB565 value drawn for each Shade, read with pgm_read_word
+const uint16_t shadeColour[NUM_SHADES] PROGMEM = {BLACK, GREEN, BLUE, ORANGE, MAGENTA, YELLOW, CYAN};
+
+// what is currently on the screen
+static uint16_t shownLevel;
+static int32_t shownScore;
+static uint16_t shownStacks; // the stack whose preview is shown
+static uint16_t bannerLevel; // the last level "LEVEL UP!" was shown for
+static bool stackShown = false;
+
+/*Prints the in-game display to the TFT screen, including
+the title, level, score, and next block.*/
+void drawGameScreen(const Session* session) {
+    tft.fillScreen(0);
+    tft.fillRect(60,0,67,9,RED);
+    tft.fillRect(61,9,128,160,BROWN);
+
+    tft.setTextColor(WHITE);
+
+    //print Mega Columns
+    tft.setCursor(71,19);
+    tft.setTextSize(2);
+    tft.setTextColor(GREEN);
+    tft.setTextWrap(false);
+    tft.setTextSize(2);
+    tft.print(F("M"));
+    tft.setTextColor(BLUE);
+    tft.print(F("E"));
+    tft.setTextColor(ORANGE);
+    tft.print(F("G"));
+    tft.setTextColor(MAGENTA);
+    tft.println(F("A"));
+    tft.setTextColor(CYAN);
+    tft.setTextSize(1);
+    tft.setCursor(73,41);
+    tft.println(F("COLUMNS"));
+
+    //print level
+    tft.setTextColor(WHITE);
+    tft.setTextSize(1);
+    tft.setCursor(64,60);
+    tft.print(F("LEVEL:"));
+    tft.println(session->game.level);
+
+    //print score
+    tft.setCursor(64,75);
+    tft.print(F("SCORE:"));
+    tft.print(session->game.score);
+
+    tft.setCursor(64,90);
+    tft.print(F("NEXT:"));
+    shownLevel = session->game.level;
+    shownScore = session->game.score;
+}
+
+/*Forgets the preview and the falling stack shown so far, for a session
+that is about to start ticking.*/
+void startDrawing(const Session* session) {
+    shownStacks = 0;
+    bannerLevel = session->game.level;
+    stackShown = false;
+}
+
+/*Reprints the updated score to the TFT screen after block sequences have been removed.*/
+static void updateScore(const Session* session) {
+    tft.setCursor(100,75);
+    tft.setTextSize(1);
+    tft.setTextColor(WHITE);
+    tft.fillRect(98,75,30,10,BROWN);
+    tft.print(session->game.score);
+}
+
+/*Reprints the level to the TFT screen.*/
+static void updateLevel(const Session* session) {
+    tft.setCursor(100,60);
+    tft.setTextSize(1);
+    tft.setTextColor(WHITE);
+    tft.fillRect(98,60,30,10,BROWN);
+    tft.print(session->game.level);
+}
+
+/*Redraws the level and score if they have changed since they were last shown.*/
+void refreshHud(const Session* session) {
+    if (shownLevel != session->game.level) {
+        updateLevel(session);
+        shownLevel = session->game.level;
+    }
+    if (shownScore != session->game.score) {
+        updateScore(session);
+        shownScore = session->game.score;
+    }
+}
+
+/*Sends whatever the last tick changed to the screen. Returns true if the
+game has gone up a level since the last call, for the caller to show
+the banner.*/
+bool drawSession(Session* session) {
+    // the blocks of the grid that were landed on, removed or moved
+    for (int i = 0; i < NUM_COLS; ++i) {
+        for (uint16_t bits = session->ChangedMask[i]; bits != 0; bits &= bits - 1) {
+            invalidateBlock(i, __builtin_ctz(bits));
+        }
+        session->ChangedMask[i] = 0;
+    }
+    if (session->phase == Falling) {
+        setFallingStack(session->col * BLOCK_STEP, session->y, session->Bcolour, session->Mcolour, session->Tcolour);
+        stackShown = true;
+    }
+    else if (stackShown) {
+        hideFallingStack(); // the stack is now part of the grid
+        stackShown = false;
+    }
+    PROFILE_BEGIN(PhasePlayfield);
+    drawPlayfield(&session->game);
+    PROFILE_END(PhasePlayfield);
+
+    if (shownStacks != session->stacks) { // a new stack has come in
+        PROFILE_BEGIN(PhasePreview);
+        blitStack(88, 130, session->nextBcolour, session->nextMcolour, session->nextTcolour); // the preview of the next stack
+        PROFILE_END(PhasePreview);
+        shownStacks = session->stacks;
+    }
+    if (bannerLevel == session->game.level) {
+        return false;
+    }
+    bannerLevel = session->game.level;
+    if (fallSpeed(session->game.level) == MAX_FALL_SPEED && fallSpeed(session->game.level - 1) < MAX_FALL_SPEED) {
+        tft.setCursor(66,150);
+        tft.print(F("MAX SPEED!"));
+    }
+    return true;
+}
+
+/*Shows "LEVEL UP!" in the red bar at the top right, or takes it away again.*/
+void drawLevelBanner(bool shown) {
+    if (shown) {
+        tft.setCursor(73,0);
+        tft.setTextColor(WHITE);
+        tft.setTextSize(1);
+        tft.print(F("LEVEL UP!"));
+    }
+    else {
+        tft.fillRect(61,0,67,9,RED);
+    }
+}
+
+/*Shows "PAUSED" in the red bar at the top right, or takes it away again.*/
+void drawPaused(bool shown) {
+    if (shown) {
+        tft.setCursor(71,0);
+        tft.setTextColor(WHITE);
+        tft.setTextSize(1);
+        tft.print(F("PAUSED"));
+    }
+    else {
+        tft.fillRect(60,0,67,9, RED);
+    }
+}
+
+/*Prints game over to the tft screen to end the game.*/
+void drawGameOver() {
+    tft.setCursor(15,25);
+    tft.setTextSize(4);
+    tft.setTextColor(RED);
+    tft.println(F("GAME"));
+    tft.setCursor(10,90);
+    tft.println(F("OVER!"));
+    tft.fillRect(0,0,61,9, RED);
+}
+
+/*Shows under "GAME OVER!" the place the score took in the high score table.*/
+void drawHighScore(int place) {
+    tft.setCursor(4,140);
+    tft.setTextSize(1);
+    tft.setTextColor(YELLOW);
+    tft.print(F("HIGH SCORE #"));
+    tft.print(place + 1);
+}
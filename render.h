@@ -0,0 +1,25 @@
+/*The game screen: the panel on the right with the title, level, score
+and NEXT stack, the playfield, the level up and pause banners and game
+over. These functions only read the Session and draw with tft and the
+bursts of spiqueue.h; they never read the controls or the clock, so the host
+can draw whole games with the recording display in host/mock/ and
+measure what every frame costs (see host/renderbench.cpp).*/
+
+#ifndef RENDER_H
+#define RENDER_H
+
+#include "session.h"
+
+#define BANNER_DELAY 1000 // how long "LEVEL UP!" is shown
+#define HUD_PERIOD 100 // how often the level and score are brought up to date
+
+void drawGameScreen(const Session* session);
+void startDrawing(const Session* session);
+bool drawSession(Session* session);
+void refreshHud(const Session* session);
+void drawLevelBanner(bool shown);
+void drawPaused(bool shown);
+void drawGameOver();
+void drawHighScore(int place);
+
+#endif
@@ -0,0 +1,152 @@
+#include "sampler.h"
+
+#ifdef SAMPLE
+#include <Arduino.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+// the end of the program in flash, from the linker
+extern "C" char _etext;
+
+// the program counter the last sample interrupted, as the AVR pushes it:
+// the high byte first (on a 3 byte PC), in words rather than bytes
+extern "C" volatile uint8_t samplePc[3];
+volatile uint8_t samplePc[3];
+
+static uint16_t counts[SAMPLE_BINS];
+static volatile uint32_t samples = 0;
+static uint8_t shift; // a bin covers 1 << shift bytes of flash
+static uint16_t binsUsed; // the bins that cover the program
+
+// named like a vector, so gcc gives it the prologue and epilogue of an interrupt
+extern "C" void __vector_sample() __attribute__((signal, used, externally_visible));
+
+/*Copies the interrupted program counter off the stack before anything
+else is pushed on it, then carries on in __vector_sample(), which
+returns to the interrupted code. None of the instructions changes SREG.*/
+ISR(TIMER3_COMPA_vect, ISR_NAKED) {
+    asm volatile(
+        "push r24" "\n\t"
+        "push r30" "\n\t"
+        "push r31" "\n\t"
+        "in r30, __SP_L__" "\n\t"
+        "in r31, __SP_H__" "\n\t"
+#ifdef __AVR_3_BYTE_PC__
+        "ldd r24, Z+4" "\n\t"
+        "sts samplePc, r24" "\n\t"
+        "ldd r24, Z+5" "\n\t"
+        "sts samplePc+1, r24" "\n\t"
+        "ldd r24, Z+6" "\n\t"
+        "sts samplePc+2, r24" "\n\t"
+#else
+        "sts samplePc, __zero_reg__" "\n\t"
+        "ldd r24, Z+4" "\n\t"
+        "sts samplePc+1, r24" "\n\t"
+        "ldd r24, Z+5" "\n\t"
+        "sts samplePc+2, r24" "\n\t"
+#endif
+        "pop r31" "\n\t"
+        "pop r30" "\n\t"
+        "pop r24" "\n\t"
+        "%~jmp __vector_sample" "\n\t"
+        ::
+    );
+}
+
+/*Counts the sample in the bin of its address.*/
+void __vector_sample() {
+    uint32_t address = (((uint32_t) samplePc[0] << 16) | ((uint32_t) samplePc[1] << 8) | samplePc[2]) << 1;
+    uint32_t bin = address >> shift;
+    if (bin < SAMPLE_BINS && counts[bin] < 0xFFFF) {
+        ++counts[bin];
+    }
+    ++samples; // the ones outside every bin are the difference
+}
+
+/*Sets up Timer3 to interrupt SAMPLE_TIMER_TOP + 1 cycles of clk/8 apart
+and sizes the bins to the program. Sampling starts with sampleStart().*/
+void sampleBegin() {
+    uint32_t end = pgm_get_far_address(_etext);
+    shift = 1;
+    while ((end >> shift) >= SAMPLE_BINS) {
+        ++shift;
+    }
+    binsUsed = (end >> shift) + 1;
+    sampleClear();
+    TCCR3A = 0;
+    TCCR3B = _BV(WGM32) | _BV(CS31); // clear the count on OCR3A, clk/8
+    OCR3A = SAMPLE_TIMER_TOP;
+}
+
+void sampleStart() {
+    TCNT3 = 0;
+    TIMSK3 |= _BV(OCIE3A);
+}
+
+void sampleStop() {
+    TIMSK3 &= ~_BV(OCIE3A);
+}
+
+/*Forgets every sample taken so far.*/
+void sampleClear() {
+    uint8_t oldSREG = SREG;
+    cli();
+    memset(counts, 0, sizeof(counts));
+    samples = 0;
+    SREG = oldSREG;
+}
+
+// the Fletcher-16 sums of the dump being sent
+static uint16_t sumA, sumB;
+
+static void sendByte(uint8_t byte) {
+    Serial.write(byte);
+    sumA = (sumA + byte) % 255;
+    sumB = (sumB + sumA) % 255;
+}
+
+static void sendLittle(uint32_t value, uint8_t count) {
+    for (uint8_t i = 0; i < count; ++i, value >>= 8) {
+        sendByte(value);
+    }
+}
+
+/*Sends the histogram over the serial port, in the layout of sampler.h.
+Sampling pauses while it goes out (about 20 ms), so that the dump does
+not count itself.*/
+void sampleDump() {
+    bool wasSampling = TIMSK3 & _BV(OCIE3A);
+    sampleStop();
+    Serial.write('M');
+    Serial.write('C');
+    Serial.write('S');
+    Serial.write(SAMPLE_VERSION);
+    sumA = sumB = 0;
+    sendByte(shift);
+    sendLittle(binsUsed, 2);
+    sendLittle(samples, 4);
+    for (uint16_t bin = 0; bin < binsUsed; ++bin) {
+        sendLittle(counts[bin], 2);
+    }
+    Serial.write(sumA);
+    Serial.write(sumB);
+    Serial.flush();
+    if (wasSampling) {
+        sampleStart();
+    }
+}
+
+/*Called from the main loop: acts on the commands read from the serial port.*/
+void samplePoll() {
+    while (Serial.available() > 0) {
+        int command = Serial.read();
+        if (command == 'D') {
+            sampleDump();
+        }
+        else if (command == 'C') {
+            sampleClear();
+        }
+    }
+}
+
+#endif
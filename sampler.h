@@ -0,0 +1,48 @@
+/*A sampling profiler for the Arduino, built with "make upload SAMPLE=1".
+About a thousand times a second Timer3 interrupts whatever the game is
+doing and counts the address it was interrupted at in a histogram of
+the program: bin i counts the samples between byte addresses i << shift
+and (i+1) << shift, with the shift picked at startup so the bins just
+cover the program. Nothing has to be wrapped, so the time spent inside
+the libraries (Adafruit_GFX, SPI, SD, the Arduino core) shows up too.
+The time spent in other interrupts is counted against the code they
+interrupted, since the sampling interrupt waits for them to finish.
+
+Sampling starts with the game and stops at game over. Sending 'D' over
+the serial port dumps the histogram (sending 'C' clears it), and it is
+dumped once more at game over. build-host/pcprof matches the bins to
+the functions of the ELF file the build made and prints a flat profile.
+Like the phase profiler (see profile.h), the serial port runs at
+SAMPLE_BAUD and carries no game log.
+
+Dump layout (numbers are little endian):
+  'M' 'C' 'S' SAMPLE_VERSION
+  shift (1 byte), bins sent (2 bytes), samples taken (4 bytes)
+  the count of every bin (2 bytes each, stuck at 65535)
+  Fletcher-16 checksum of everything after the version (2 bytes)*/
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <stdint.h>
+
+#define SAMPLE_VERSION 1
+#define SAMPLE_BAUD 500000
+#define SAMPLE_BINS 512
+#define SAMPLE_TIMER_TOP 1999 // 16 MHz / 8 / 2000 = 1000 samples a second
+#define SAMPLE_HEADER_SIZE 11 // everything before the bins
+
+#ifdef SAMPLE
+#ifdef PROFILE
+#error "the two profilers share the serial port, build with one of them"
+#endif
+
+void sampleBegin();
+void sampleStart();
+void sampleStop();
+void sampleClear();
+void sampleDump();
+void samplePoll();
+#endif
+
+#endif
@@ -0,0 +1,142 @@
+#include <Arduino.h>
+#include <SD.h>
+
+#include "scheduler.h"
+#include "profile.h"
+#include "savegame.h"
+
+#define SLOT_A "SAVEA.DAT" // the snapshots with an even sequence
+#define SLOT_B "SAVEB.DAT"
+#define SCORES_FILE "SCORES.DAT"
+
+HighScoreTable highScores;
+
+static bool cardReady = false;
+static uint16_t sequence = 0; // of the newest snapshot, written or found
+static uint8_t snapshot[SNAPSHOT_SIZE]; // the one being written
+static bool written; // the snapshot has gone into the file, which is still to be closed
+static File saveFile;
+static SaveSpareHook spareHook = 0;
+
+// FILE_WRITE appends, these replace what was in the file
+#define FILE_REPLACE (O_WRITE | O_CREAT | O_TRUNC)
+
+/*Reads count bytes from the start of a file. Returns false if there are not that many.*/
+static bool readFile(const char* name, uint8_t* bytes, uint16_t count) {
+    File file = SD.open(name);
+    if (!file) {
+        return false;
+    }
+    bool whole = file.read(bytes, count) == count;
+    file.close();
+    return whole;
+}
+
+/*Starts keeping the game on the card and reads the high scores. Call
+once SD.begin() has succeeded.*/
+void savegameBegin() {
+    cardReady = true;
+    uint8_t bytes[HIGH_SCORES_SIZE];
+    if (!readFile(SCORES_FILE, bytes, HIGH_SCORES_SIZE) || !loadHighScores(bytes, &highScores)) {
+        memset(&highScores, 0, sizeof(highScores));
+    }
+}
+
+/*Sets the function that tells saveStep() how long it has before the
+next tick, or 0 to write without waiting.*/
+void saveSetSpareHook(SaveSpareHook hook) {
+    spareHook = hook;
+}
+
+/*Loads the newest good snapshot on the card into session. Returns false
+if there is none.*/
+bool findSnapshot(Session* session, uint32_t* seed) {
+    bool found = false;
+    for (int slot = 0; slot < 2 && cardReady; ++slot) {
+        Session loaded;
+        uint32_t loadedSeed;
+        uint16_t loadedSequence;
+        if (readFile(slot == 0 ? SLOT_A : SLOT_B, snapshot, SNAPSHOT_SIZE) &&
+                loadSnapshot(snapshot, &loaded, &loadedSeed, &loadedSequence) &&
+                (!found || (int16_t) (loadedSequence - sequence) > 0)) {
+            *session = loaded;
+            *seed = loadedSeed;
+            sequence = loadedSequence;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/*One step of writing the snapshot: opening its file, writing it into
+the library's buffer, or closing the file, which writes the buffer and
+the directory entry to the card. Each can take several milliseconds
+(profiled as PhaseSave), so they are spread over three passes of the
+main loop, and each waits until there is SAVE_SPARE_US to go before the
+next tick.*/
+static long saveStep() {
+    if (spareHook != 0 && spareHook() < SAVE_SPARE_US) {
+        return 1;
+    }
+    PROFILE_BEGIN(PhaseSave);
+    long wait = 0;
+    if (!saveFile) {
+        saveFile = SD.open(sequence & 1 ? SLOT_B : SLOT_A, FILE_REPLACE);
+        if (!saveFile) {
+            wait = TASK_DONE;
+        }
+    }
+    else if (!written) {
+        saveFile.write(snapshot, SNAPSHOT_SIZE);
+        written = true;
+    }
+    else {
+        saveFile.close();
+        wait = TASK_DONE;
+    }
+    PROFILE_END(PhaseSave);
+    return wait;
+}
+
+/*Takes a snapshot of session, started with seed, and starts writing it
+to the card. Does nothing while the last one is still being written.*/
+void saveGame(const Session* session, uint32_t seed) {
+    if (!cardReady || taskRunning(saveStep)) {
+        return;
+    }
+    saveSnapshot(session, seed, ++sequence, snapshot);
+    written = false;
+    startTask(saveStep, 0);
+}
+
+/*Stops the snapshot being written and removes both, for a game that
+has ended or is not going to be resumed.*/
+void clearSaves() {
+    if (!cardReady) {
+        return;
+    }
+    stopTask(saveStep);
+    if (saveFile) {
+        saveFile.close();
+    }
+    SD.remove(SLOT_A);
+    SD.remove(SLOT_B);
+}
+
+/*Puts the score of a finished game into the high score table and, if it
+took a place, writes the table to the card. Returns the place (0 is the
+best), or -1.*/
+int recordHighScore(const Session* session) {
+    int place = addHighScore(&highScores, session);
+    if (place < 0 || !cardReady) {
+        return place;
+    }
+    uint8_t bytes[HIGH_SCORES_SIZE];
+    saveHighScores(&highScores, bytes);
+    File file = SD.open(SCORES_FILE, FILE_REPLACE);
+    if (file) {
+        file.write(bytes, HIGH_SCORES_SIZE);
+        file.close();
+    }
+    return place;
+}
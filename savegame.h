@@ -0,0 +1,39 @@
+/*Keeps the game in progress and the best scores on the SD card, in the
+formats of snapshot.h. Every SAVE_TICKS of play, and whenever the game
+is paused, the session is copied into a snapshot in RAM, which a task
+then writes out over the next three passes of the main loop (opening
+the file, writing the bytes, closing it). Opening and closing go to the
+card and can take milliseconds, so a step only starts once the game has
+at least SAVE_SPARE_US to go before its next tick (see
+saveSetSpareHook()); "make upload PROFILE=1" times every step as
+PhaseSave, and its longest is what SAVE_SPARE_US has to cover. The
+snapshots go to SAVEA.DAT
+and SAVEB.DAT in turn, so pulling the power half way through a write
+still leaves the one before it; the next start offers the newest good
+one. At game over both are removed and the score is put into SCORES.DAT.
+
+Without a card (or in a build that replays a log) nothing is saved and
+there is nothing to resume.*/
+
+#ifndef SAVEGAME_H
+#define SAVEGAME_H
+
+#include "session.h"
+#include "snapshot.h"
+
+#define SAVE_TICKS (5000 / TICK_MS) // a snapshot every 5 s of play
+#define SAVE_SPARE_US 5000 // the time a step of the write may take before the next tick is late
+
+// returns how many microseconds are left before the next tick
+typedef long (*SaveSpareHook)();
+
+extern HighScoreTable highScores;
+
+void savegameBegin();
+void saveSetSpareHook(SaveSpareHook hook);
+bool findSnapshot(Session* session, uint32_t* seed);
+void saveGame(const Session* session, uint32_t seed);
+void clearSaves();
+int recordHighScore(const Session* session);
+
+#endif
@@ -0,0 +1,81 @@
+#include <Arduino.h>
+
+#include "scheduler.h"
+
+struct Task {
+    TaskStep step; // 0 when the slot is free
+    unsigned long due; // millis() value at which the next step runs
+};
+
+static Task tasks[MAX_TASKS];
+
+/*Returns the slot of a task, or 0 if it is not running.*/
+static Task* findTask(TaskStep step) {
+    for (int i = 0; i < MAX_TASKS; ++i) {
+        if (tasks[i].step == step) {
+            return &tasks[i];
+        }
+    }
+    return 0;
+}
+
+/*Runs the first step of a task wait milliseconds from now. A task that is
+already running is rescheduled instead. Returns false if all the slots
+are taken.*/
+bool startTask(TaskStep step, unsigned long wait) {
+    Task* task = findTask(step);
+    if (task == 0) {
+        task = findTask(0);
+        if (task == 0) {
+            return false;
+        }
+    }
+    task->step = step;
+    task->due = millis() + wait;
+    return true;
+}
+
+/*Stops a task before its next step. Does nothing if it is not running.*/
+void stopTask(TaskStep step) {
+    Task* task = findTask(step);
+    if (task != 0) {
+        task->step = 0;
+    }
+}
+
+bool taskRunning(TaskStep step) {
+    return findTask(step) != 0;
+}
+
+void stopAllTasks() {
+    for (int i = 0; i < MAX_TASKS; ++i) {
+        tasks[i].step = 0;
+    }
+}
+
+/*Runs the step of every task that is due. The next step is timed from
+when this one was due rather than from now, so a step that runs a little
+late does not push back all the ones after it. A task that has fallen
+more than a whole wait behind starts again from now instead of running
+several steps in a row to catch up.*/
+void runTasks() {
+    for (int i = 0; i < MAX_TASKS; ++i) {
+        TaskStep step = tasks[i].step;
+        unsigned long now = millis();
+        if (step == 0 || (long) (now - tasks[i].due) < 0) {
+            continue;
+        }
+        long wait = step();
+        if (tasks[i].step != step) { // the step stopped or replaced its own task
+            continue;
+        }
+        if (wait < 0) {
+            tasks[i].step = 0;
+            continue;
+        }
+        tasks[i].due += wait;
+        if ((long) (now - tasks[i].due) > 0) {
+            tasks[i].due = now;
+        }
+    }
+}
@@ -0,0 +1,22 @@
+/*A small cooperative scheduler for the game's timed work. A task is a
+function that does one step of its work and returns how many
+milliseconds to wait before its next step (or TASK_DONE to stop), so
+anything that used to wait with delay() is written as a state machine
+that returns the wait instead. runTasks() is called over and over from
+the main loop and never blocks.*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#define MAX_TASKS 8
+#define TASK_DONE -1
+
+typedef long (*TaskStep)();
+
+bool startTask(TaskStep step, unsigned long wait);
+void stopTask(TaskStep step);
+bool taskRunning(TaskStep step);
+void stopAllTasks();
+void runTasks();
+
+#endif
@@ -0,0 +1,160 @@
+#include "session.h"
+
+#include <string.h>
+
+/*The grid row of the bottom block of a stack whose bottom block is at y
+on the screen (the row it is in, or the one it is moving into).*/
+int stackRow(int y) {
+    return NUM_ROWS - 1 - (y - FALL_TOP) / CELL_PIXELS;
+}
+
+/*Drops the next stack in at the top of the grid and picks the one after it.*/
+static void newStack(Session* session) {
+    session->Bcolour = session->nextBcolour;
+    session->Mcolour = session->nextMcolour;
+    session->Tcolour = session->nextTcolour;
+    randomStack(&session->game, &session->nextBcolour, &session->nextMcolour, &session->nextTcolour);
+    session->col = ENTER_COL;
+    session->y = 0;
+    session->fallFraction = 0;
+    ++session->stacks;
+    session->phase = Falling;
+}
+
+/*Starts a new game. The first stack is already falling when this returns.*/
+void resetSession(Session* session, int difficulty, uint32_t seed) {
+    memset(session, 0, sizeof(*session));
+    resetGame(&session->game, difficulty, seed);
+    session->speed = fallSpeed;
+    randomStack(&session->game, &session->nextBcolour, &session->nextMcolour, &session->nextTcolour);
+    newStack(session);
+}
+
+/*Tells the session about a change of the controls. It takes effect in
+the next tick. value is the direction of the joystick for MoveInput
+and DropInput (only down, 1, drops) and is ignored for RotateInput.*/
+void sessionInput(Session* session, uint8_t input, int8_t value) {
+    if (input == MoveInput) {
+        session->joyH = value;
+        if (value != 0) {
+            session->pendingMove = value; // even a flick between two ticks moves the stack
+        }
+    }
+    else if (input == DropInput) {
+        session->dropping = value > 0;
+    }
+    else if (session->phase == Falling) {
+        // bottom to top, other two colours move down
+        Shade tmp = session->Bcolour;
+        session->Bcolour = session->Mcolour;
+        session->Mcolour = session->Tcolour;
+        session->Tcolour = tmp;
+    }
+}
+
+/*Moves the stack one column if the joystick has been pushed left or right
+since the last tick, or every MOVE_REPEAT_TICKS while it is held there,
+as long as the column next to it is empty at the height of the stack:
+the row its bottom block is in and, between two rows, the one below.*/
+static void moveSideways(Session* session) {
+    int direction = session->pendingMove;
+    session->pendingMove = 0;
+    if (direction == 0 && session->joyH != 0 && session->tick - session->lastMove >= MOVE_REPEAT_TICKS) {
+        direction = session->joyH;
+    }
+    if (direction == 0) {
+        return;
+    }
+    session->lastMove = session->tick;
+
+    int col = session->col + direction;
+    if (col < 0 || col >= NUM_COLS) {
+        return;
+    }
+    int row = stackRow(session->y);
+    bool between = session->y > FALL_TOP && (session->y - FALL_TOP) % CELL_PIXELS != 0;
+    if (blockAt(&session->game, col, row) == Black && (!between || blockAt(&session->game, col, row - 1) == Black)) {
+        session->col = col;
+    }
+}
+
+/*Called once the grid has settled after a stack landed: ends the game
+if the grid is full, moves up a level every minute and drops the next stack.*/
+static void landed(Session* session, int row) {
+    //game over if any of the three blocks in the stack are at the top of the grid after checking is complete
+    if (stackOverflowed(&session->game, session->col, row)) {
+        session->phase = Over;
+        return;
+    }
+    if (session->tick - session->levelStart >= LEVEL_TICKS) {
+        nextLevel(&session->game);
+        session->levelStart = session->tick;
+    }
+    newStack(session);
+}
+
+/*One tick of the falling stack: reads the controls, moves it down by
+however far it falls in a tick at the speed of the level, one pixel at a
+time so it stops on whatever it reaches, and lands it if it has.*/
+static void fall(Session* session) {
+    Game* game = &session->game;
+    uint32_t speed = session->speed(game->level);
+    if (session->dropping && speed < DROP_SPEED) {
+        speed = DROP_SPEED;
+    }
+    session->fallFraction += speed * TICK_US;
+    int pixels = session->fallFraction >> FALL_SHIFT;
+    session->fallFraction &= ((uint32_t) 1 << FALL_SHIFT) - 1;
+
+    moveSideways(session);
+
+    for (; pixels > 0; --pixels) {
+        int row = stackRow(session->y);
+        //when the blocks have reached the bottom of the screen or have landed on another stack
+        if (session->y == FALL_BOTTOM || blockAt(game, session->col, row - 1) != Black) {
+            landStack(game, session->col, row, session->Bcolour, session->Mcolour, session->Tcolour);
+            for (int k = 0; k < 3 && row + k < NUM_ROWS; ++k) {
+                session->ChangedMask[session->col] |= 1 << (row + k);
+            }
+            session->phase = Checking;
+            return;
+        }
+        ++session->y;
+    }
+}
+
+/*Checking a landed stack goes through the steps of the cascade one at a
+time (see cascadeStep()): each removes the sequences and lets the blocks
+above fall into the gaps, all of them at once, and is shown for
+SHIFT_TICKS before the next, until nothing more falls.*/
+static void cascade(Session* session) {
+    if (session->wait > 0) {
+        --session->wait;
+        return;
+    }
+    // the engine works out the step and the display redraws what it changed
+    CascadeStep step;
+    bool fell = cascadeStep(&session->game, &step);
+    for (int i = 0; i < NUM_COLS; ++i) {
+        session->ChangedMask[i] |= step.cleared[i] | step.moved[i];
+    }
+    if (fell) { // re-check once the fall has been shown
+        session->wait = SHIFT_TICKS - 1;
+        return;
+    }
+    landed(session, stackRow(session->y));
+}
+
+/*Runs the game for one tick.*/
+void sessionTick(Session* session) {
+    if (session->phase == Over) {
+        return;
+    }
+    if (session->phase == Falling) {
+        fall(session);
+    }
+    else {
+        cascade(session);
+    }
+    ++session->tick;
+}
@@ -0,0 +1,69 @@
+/*A game in progress, from the first stack to game over, as a
+deterministic state machine: everything that happens depends only on the
+seed, the difficulty and which inputs arrived before which tick. The
+Arduino calls sessionTick() every TICK_MS, running the ticks it missed
+in a row if drawing took longer, and draws what changed; the host can
+run the same session from a recorded log (see gamelog.h) without any
+hardware, as fast as it likes.*/
+
+#ifndef SESSION_H
+#define SESSION_H
+
+#include "engine.h"
+
+#define TICK_MS 10 // how much game time one tick is
+#define TICK_US (TICK_MS * 1000L)
+#define MAX_CATCH_UP 5 // ticks run in a row before drawing, when drawing has fallen behind
+
+// the falling stack moves in screen pixels (these match display.h)
+#define FALL_TOP 9 // the y of the bottom block when it is in the top row
+#define FALL_BOTTOM 149 // the y of the bottom block when it is in the bottom row
+#define CELL_PIXELS 10
+#define ENTER_COL 2 // the third column, where each stack starts
+
+#define SHIFT_TICKS 30 // how long blocks that fell into the gaps are shown before the next check
+#define MOVE_REPEAT_TICKS 10 // how often the stack moves sideways while the joystick is held
+#define LEVEL_TICKS 6000 // a level lasts a minute
+
+// the inputs that change the game, the value is as in input.h
+enum SessionInput {MoveInput, DropInput, RotateInput};
+
+enum SessionPhase {Falling, Checking, Over};
+
+struct Session {
+    Game game;
+    uint32_t tick; // ticks run so far
+    uint8_t phase;
+
+    // the falling stack
+    int col;
+    int y; // the y of the top of the bottom block on the screen
+    uint32_t fallFraction; // how far below y the stack is, in 1/2^FALL_SHIFT pixels
+    Shade Bcolour;
+    Shade Mcolour;
+    Shade Tcolour;
+    Shade nextBcolour;
+    Shade nextMcolour;
+    Shade nextTcolour;
+    uint16_t stacks; // the number of stacks dropped so far
+
+    // the controls
+    int8_t joyH; // where the joystick is held: -1 = left, 0 = centre, 1 = right
+    int8_t pendingMove; // the joystick was pushed left (-1) or right (1) since the last tick
+    bool dropping; // the joystick is held down
+    uint32_t lastMove; // the tick the stack last moved sideways
+
+    // the blocks falling into the gaps after a stack lands
+    uint16_t wait; // ticks left before the next check or settle step
+
+    uint32_t levelStart; // the tick the level started
+    SpeedCurve speed; // fallSpeed, unless a test on the host tries another curve
+    uint16_t ChangedMask[NUM_COLS]; // blocks of the grid that changed, for the display to clear
+};
+
+int stackRow(int y);
+void resetSession(Session* session, int difficulty, uint32_t seed);
+void sessionInput(Session* session, uint8_t input, int8_t value);
+void sessionTick(Session* session);
+
+#endif
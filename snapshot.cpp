@@ -0,0 +1,221 @@
+#include "snapshot.h"
+
+#include <string.h>
+
+/*The CRC-16 (CCITT, 0x1021, starting at 0xFFFF) of count bytes. Unlike a
+sum, it also catches bytes that were swapped or torn off a block.*/
+static uint16_t crc16(const uint8_t* bytes, int count) {
+    uint16_t crc = 0xFFFF;
+    for (int k = 0; k < count; ++k) {
+        crc ^= (uint16_t) bytes[k] << 8;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+/*Writes the lowest count bytes of value, lowest first, and moves past them.*/
+static void put(uint8_t** out, uint32_t value, int count) {
+    for (int k = 0; k < count; ++k) {
+        *(*out)++ = value >> (8 * k);
+    }
+}
+
+/*Reads a little endian number of count bytes and moves past it.*/
+static uint32_t get(const uint8_t** in, int count) {
+    uint32_t value = 0;
+    for (int k = 0; k < count; ++k) {
+        value |= (uint32_t) *(*in)++ << (8 * k);
+    }
+    return value;
+}
+
+/*Writes the SNAPSHOT_SIZE bytes of a snapshot of session, started with
+seed, into out.*/
+void saveSnapshot(const Session* session, uint32_t seed, uint16_t sequence, uint8_t* out) {
+    const Game* game = &session->game;
+    uint8_t* p = out;
+    put(&p, 'M', 1);
+    put(&p, 'C', 1);
+    put(&p, 'G', 1);
+    put(&p, SNAPSHOT_VERSION, 1);
+    put(&p, sequence, 2);
+    put(&p, seed, 4);
+    put(&p, game->difficulty, 1);
+    put(&p, game->level, 2);
+    put(&p, game->score, 4);
+    put(&p, game->random, 4);
+    for (int b = 0; b < 3; ++b) {
+        for (int i = 0; i < NUM_COLS; ++i) {
+            put(&p, game->ColourBits[b][i], 2);
+        }
+    }
+    for (int i = 0; i < NUM_COLS; ++i) {
+        put(&p, game->MatchMask[i], 2);
+    }
+    for (int i = 0; i < NUM_COLS; ++i) {
+        put(&p, game->DirtyMask[i], 2);
+    }
+    put(&p, session->tick, 4);
+    put(&p, session->phase, 1);
+    put(&p, session->col, 1);
+    put(&p, session->y, 2);
+    put(&p, session->fallFraction, 4);
+    put(&p, session->Bcolour | session->Mcolour << 4, 1);
+    put(&p, session->Tcolour | session->nextBcolour << 4, 1);
+    put(&p, session->nextMcolour | session->nextTcolour << 4, 1);
+    put(&p, session->stacks, 2);
+    put(&p, session->joyH, 1);
+    put(&p, session->pendingMove, 1);
+    put(&p, session->lastMove, 4);
+    put(&p, session->dropping, 1);
+    put(&p, session->wait, 2);
+    put(&p, session->levelStart, 4);
+    put(&p, crc16(out, SNAPSHOT_SIZE - 2), 2);
+}
+
+/*Loads the snapshot in bytes (SNAPSHOT_SIZE of them) into session, with
+the seed and sequence it was saved with. Every block of the grid is
+marked changed, for the display to draw them all. Returns false, leaving
+session alone, if it is not a whole, correct snapshot of a game in play.*/
+bool loadSnapshot(const uint8_t* bytes, Session* session, uint32_t* seed, uint16_t* sequence) {
+    const uint8_t* end = bytes + SNAPSHOT_SIZE - 2;
+    if (bytes[0] != 'M' || bytes[1] != 'C' || bytes[2] != 'G' || bytes[3] != SNAPSHOT_VERSION ||
+            crc16(bytes, SNAPSHOT_SIZE - 2) != get(&end, 2)) {
+        return false;
+    }
+    const uint8_t* p = bytes + 4;
+    uint16_t savedSequence = get(&p, 2);
+    uint32_t savedSeed = get(&p, 4);
+    int difficulty = get(&p, 1);
+    if (difficulty < 3 || difficulty > 6) {
+        return false;
+    }
+
+    Session loaded;
+    memset(&loaded, 0, sizeof(loaded));
+    Game* game = &loaded.game;
+    resetGame(game, difficulty, 0);
+    game->level = get(&p, 2);
+    game->score = get(&p, 4);
+    game->random = get(&p, 4);
+    for (int b = 0; b < 3; ++b) {
+        for (int i = 0; i < NUM_COLS; ++i) {
+            game->ColourBits[b][i] = get(&p, 2);
+        }
+    }
+    for (int i = 0; i < NUM_COLS; ++i) {
+        game->MatchMask[i] = get(&p, 2);
+    }
+    for (int i = 0; i < NUM_COLS; ++i) {
+        game->DirtyMask[i] = get(&p, 2);
+    }
+    // the shade masks follow from the colours
+    memset(game->ShadeMask, 0, sizeof(game->ShadeMask));
+    for (int i = 0; i < NUM_COLS; ++i) {
+        for (int j = 0; j < NUM_ROWS; ++j) {
+            Shade shade = blockAt(game, i, j);
+            if (shade >= NUM_SHADES) {
+                return false;
+            }
+            game->ShadeMask[shade][i] |= 1 << j;
+            if (shade != Black) {
+                loaded.ChangedMask[i] |= 1 << j;
+            }
+        }
+    }
+#ifdef ZOBRIST
+    game->zobrist = zobristBoard(game);
+#endif
+
+    loaded.tick = get(&p, 4);
+    loaded.phase = get(&p, 1);
+    loaded.col = get(&p, 1);
+    if (loaded.phase >= Over || loaded.col >= NUM_COLS) {
+        return false;
+    }
+    loaded.y = (int16_t) get(&p, 2);
+    loaded.fallFraction = get(&p, 4);
+    Shade shades[6];
+    for (int k = 0; k < 6; k += 2) {
+        uint8_t pair = get(&p, 1);
+        shades[k] = (Shade) (pair & 0x0F);
+        shades[k+1] = (Shade) (pair >> 4);
+        if (shades[k] >= NUM_SHADES || shades[k+1] >= NUM_SHADES) {
+            return false;
+        }
+    }
+    loaded.Bcolour = shades[0];
+    loaded.Mcolour = shades[1];
+    loaded.Tcolour = shades[2];
+    loaded.nextBcolour = shades[3];
+    loaded.nextMcolour = shades[4];
+    loaded.nextTcolour = shades[5];
+    loaded.stacks = get(&p, 2);
+    loaded.joyH = (int8_t) get(&p, 1);
+    loaded.pendingMove = (int8_t) get(&p, 1);
+    loaded.lastMove = get(&p, 4);
+    loaded.dropping = get(&p, 1);
+    loaded.wait = get(&p, 2);
+    loaded.levelStart = get(&p, 4);
+    loaded.speed = fallSpeed;
+
+    *session = loaded;
+    *seed = savedSeed;
+    *sequence = savedSequence;
+    return true;
+}
+
+/*Writes the HIGH_SCORES_SIZE bytes of the table into out.*/
+void saveHighScores(const HighScoreTable* table, uint8_t* out) {
+    uint8_t* p = out;
+    put(&p, 'M', 1);
+    put(&p, 'C', 1);
+    put(&p, 'H', 1);
+    put(&p, HIGH_SCORES_VERSION, 1);
+    for (int k = 0; k < HIGH_SCORES; ++k) {
+        put(&p, table->place[k].score, 4);
+        put(&p, table->place[k].level, 2);
+        put(&p, table->place[k].difficulty, 1);
+    }
+    put(&p, crc16(out, HIGH_SCORES_SIZE - 2), 2);
+}
+
+/*Loads the table in bytes (HIGH_SCORES_SIZE of them). Returns false,
+leaving table alone, if it is not a whole, correct table.*/
+bool loadHighScores(const uint8_t* bytes, HighScoreTable* table) {
+    const uint8_t* end = bytes + HIGH_SCORES_SIZE - 2;
+    if (bytes[0] != 'M' || bytes[1] != 'C' || bytes[2] != 'H' || bytes[3] != HIGH_SCORES_VERSION ||
+            crc16(bytes, HIGH_SCORES_SIZE - 2) != get(&end, 2)) {
+        return false;
+    }
+    const uint8_t* p = bytes + 4;
+    for (int k = 0; k < HIGH_SCORES; ++k) {
+        table->place[k].score = get(&p, 4);
+        table->place[k].level = get(&p, 2);
+        table->place[k].difficulty = get(&p, 1);
+    }
+    return true;
+}
+
+/*Puts the score of a finished game into the table if it beats one of
+the places. Returns the place it took (0 is the best), or -1.*/
+int addHighScore(HighScoreTable* table, const Session* session) {
+    int32_t score = session->game.score;
+    if (score <= 0) {
+        return -1;
+    }
+    int place = HIGH_SCORES;
+    while (place > 0 && table->place[place - 1].score < score) {
+        --place;
+    }
+    if (place == HIGH_SCORES) {
+        return -1;
+    }
+    memmove(&table->place[place + 1], &table->place[place], (HIGH_SCORES - 1 - place) * sizeof(HighScore));
+    table->place[place].score = score;
+    table->place[place].level = session->game.level;
+    table->place[place].difficulty = session->game.difficulty;
+    return place;
+}
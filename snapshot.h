@@ -0,0 +1,56 @@
+/*A snapshot of a game in progress, small enough to write to the SD card
+every few seconds and load back in one go: the grid, the falling and
+next stacks, the score, level and difficulty, the state of the colour
+generator and every timer of the session. A session loaded from it
+carries on exactly as the saved one would have, on the Arduino or on
+the host. Alongside it, a table of the best scores.
+
+Snapshot layout (numbers are little endian):
+  'M' 'C' 'G' SNAPSHOT_VERSION, sequence (2 bytes), seed (4 bytes)
+  difficulty (1 byte), level (2 bytes), score (4 bytes), generator (4 bytes)
+  ColourBits, MatchMask and DirtyMask (2 bytes a column each)
+  tick (4 bytes), phase, col (1 byte each), y (2 bytes), fallFraction (4 bytes)
+  the falling and next stack, two Shades a byte (3 bytes), stacks (2 bytes)
+  joyH, pendingMove (1 byte each), lastMove (4 bytes)
+  dropping (1 byte), wait (2 bytes), levelStart (4 bytes)
+  CRC-16 of everything before it (2 bytes)
+The sequence goes up by one with every snapshot of a game, so of two
+good copies the newer one wins.
+
+High score layout:
+  'M' 'C' 'H' HIGH_SCORES_VERSION
+  HIGH_SCORES times score (4 bytes), level (2 bytes), difficulty (1 byte)
+  CRC-16 of everything before it (2 bytes)
+
+The snapshot version changes whenever the Session does.*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "session.h"
+
+#define SNAPSHOT_VERSION 4
+#define SNAPSHOT_SIZE 113
+#define HIGH_SCORES 5
+#define HIGH_SCORES_VERSION 1
+#define HIGH_SCORES_SIZE (4 + 7 * HIGH_SCORES + 2)
+
+struct HighScore {
+    int32_t score; // 0 for a place nobody has taken yet
+    uint16_t level;
+    uint8_t difficulty;
+};
+
+// the best scores, the best first
+struct HighScoreTable {
+    HighScore place[HIGH_SCORES];
+};
+
+void saveSnapshot(const Session* session, uint32_t seed, uint16_t sequence, uint8_t* out);
+bool loadSnapshot(const uint8_t* bytes, Session* session, uint32_t* seed, uint16_t* sequence);
+
+void saveHighScores(const HighScoreTable* table, uint8_t* out);
+bool loadHighScores(const uint8_t* bytes, HighScoreTable* table);
+int addHighScore(HighScoreTable* table, const Session* session);
+
+#endif
@@ -0,0 +1,210 @@
+#include "spiqueue.h"
+
+#ifdef __AVR__
+#include <Arduino.h>
+#include <SPI.h>
+
+#include "display.h"
+#endif
+
+enum DisplayOp {OpWindow, OpColour, OpRows, OpMarker};
+
+/*OpWindow: a = x0, b = y0, c = x1, d = y1
+OpColour: a, b = colour (high, low byte), c, d = number of pixels (high, low byte)
+OpRows:   d rows, each made of one left pixel, c inside pixels and one right
+          pixel. a = palette index of the left (high 4 bits) and inside
+          (low 4 bits) colours, b = palette index of the right pixel or
+          PALETTE_NONE if the rows have no right pixel
+OpMarker: sends nothing, a is passed to the marker hook*/
+struct DisplayCmd {
+    uint8_t op;
+    uint8_t a, b, c, d;
+};
+
+// colours used by OpRows
+static uint16_t palette[DISPLAY_PALETTE_SIZE];
+
+static DisplayMarkerHook markerHook = 0;
+
+// the command being sent
+static DisplayCmd current;
+static bool loaded = false; // current has not been sent to the end yet
+static uint8_t step; // OpWindow: the next byte
+static uint16_t runColour; // the colour of the run of pixels being sent
+static uint16_t run; // pixels of the run not started yet
+static bool lowByte; // the high byte of a pixel has been sent and the low one not
+static uint8_t part; // OpRows: 0 = left pixel, 1 = inside, 2 = right pixel
+static uint8_t rows; // OpRows: rows left after the current one
+
+/*Sets one of the colours that displayRows() refers to by index.*/
+void displaySetColour(uint8_t index, uint16_t colour) {
+    palette[index] = colour;
+}
+
+/*Sets the function called by displayMarker(), or 0 for none.*/
+void displaySetMarkerHook(DisplayMarkerHook hook) {
+    markerHook = hook;
+}
+
+/*Makes a command the one displayNextByte() sends.*/
+static void displayLoad(uint8_t op, uint8_t a, uint8_t b, uint8_t c, uint8_t d) {
+    current.op = op;
+    current.a = a;
+    current.b = b;
+    current.c = c;
+    current.d = d;
+    loaded = true;
+    step = 0;
+    run = 0;
+    lowByte = false;
+    if (op == OpColour) {
+        runColour = ((uint16_t) a << 8) | b;
+        run = ((uint16_t) c << 8) | d;
+    }
+    else if (op == OpRows) {
+        rows = d;
+        part = 2; // as if a row had just ended
+    }
+}
+
+/*Moves an OpRows command on to its next run: the left pixel, the inside
+or the right pixel of a row. Returns false once all of its rows are done.*/
+static bool nextRowRun() {
+    do {
+        if (part == 0) {
+            part = 1;
+            run = current.c;
+            runColour = palette[current.a & 0x0F];
+        }
+        else if (part == 1 && current.b != PALETTE_NONE) {
+            part = 2;
+            run = 1;
+            runColour = palette[current.b];
+        }
+        else {
+            if (rows == 0) {
+                return false;
+            }
+            --rows;
+            part = 0;
+            run = 1;
+            runColour = palette[current.a >> 4];
+        }
+    } while (run == 0);
+    return true;
+}
+
+/*Gives the next byte of the command being sent and whether it is data
+(DC high) or a command (DC low). Returns false once it has all been
+sent, calling the marker hook if the command was a marker.*/
+bool displayNextByte(uint8_t* byte, bool* data) {
+    *data = true;
+    if (!loaded) {
+        return false;
+    }
+    if (current.op == OpWindow) {
+        if (step < 11) {
+            // the column range, the row range, then start writing
+            switch (step) {
+                case 0: *byte = ST7735_CASET; break;
+                case 2: *byte = current.a; break;
+                case 4: *byte = current.c; break;
+                case 5: *byte = ST7735_RASET; break;
+                case 7: *byte = current.b; break;
+                case 9: *byte = current.d; break;
+                case 10: *byte = ST7735_RAMWR; break;
+                default: *byte = 0; break; // the high bytes of the coordinates
+            }
+            *data = step != 0 && step != 5 && step != 10;
+            ++step;
+            return true;
+        }
+    }
+    else if (current.op == OpMarker) {
+        if (markerHook != 0) {
+            markerHook(current.a);
+        }
+    }
+    else if (lowByte) {
+        *byte = runColour;
+        lowByte = false;
+        return true;
+    }
+    else if (run != 0 || (current.op == OpRows && nextRowRun())) {
+        --run;
+        *byte = runColour >> 8;
+        lowByte = true;
+        return true;
+    }
+    loaded = false;
+    return false;
+}
+
+/*Sends an address window from (x0, y0) to (x1, y1), inclusive.*/
+void displayWindow(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1) {
+    displayLoad(OpWindow, x0, y0, x1, y1);
+    displaySend();
+}
+
+/*Sends count pixels of one colour.*/
+void displayColour(uint16_t colour, uint16_t count) {
+    displayLoad(OpColour, colour >> 8, colour, count >> 8, count);
+    displaySend();
+}
+
+/*Sends rows that each have a left pixel, width inside pixels and a right
+pixel (unless right is PALETTE_NONE), all given as palette indices.*/
+void displayRows(uint8_t left, uint8_t inside, uint8_t right, uint8_t width, uint8_t rows) {
+    displayLoad(OpRows, (left << 4) | inside, right, width, rows);
+    displaySend();
+}
+
+/*Calls the marker hook with id, once everything sent before it is out.*/
+void displayMarker(uint8_t id) {
+    displayLoad(OpMarker, id, 0, 0, 0);
+    displaySend();
+}
+
+#ifdef __AVR__
+
+static volatile uint8_t* csPort;
+static uint8_t csMask;
+static volatile uint8_t* dcPort;
+static uint8_t dcMask;
+
+/*Sets up the pins used to send. Call after the display is initialized.*/
+void displayBegin() {
+    csPort = portOutputRegister(digitalPinToPort(TFT_CS));
+    csMask = digitalPinToBitMask(TFT_CS);
+    dcPort = portOutputRegister(digitalPinToPort(TFT_DC));
+    dcMask = digitalPinToBitMask(TFT_DC);
+}
+
+/*Sends the command just given in one burst, working out each byte while
+the one before it goes out.*/
+void displaySend() {
+    uint8_t byte;
+    bool data;
+    if (!displayNextByte(&byte, &data)) {
+        return;
+    }
+    *csPort &= ~csMask;
+    while (true) {
+        if (data) {
+            *dcPort |= dcMask;
+        }
+        else {
+            *dcPort &= ~dcMask;
+        }
+        SPDR = byte;
+        bool more = displayNextByte(&byte, &data);
+        while (!(SPSR & _BV(SPIF))) {
+        }
+        if (!more) {
+            break;
+        }
+    }
+    *csPort |= csMask;
+}
+
+#endif
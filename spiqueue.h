@@ -0,0 +1,43 @@
+/*Display commands for the TFT, each sent in one SPI burst as soon as it
+is given: an address window, a run of pixels of one colour, or rows made
+of a left pixel, a run of inside pixels and a right pixel whose colours
+come from a small palette. A burst waits for every byte to go out: at
+F_CPU/4 a byte lasts 32 cycles, less than an interrupt per byte would
+cost, so sending them from the SPI interrupt gives the CPU nothing back.
+Nothing is left on the bus when a function returns, so the Adafruit
+library and the SD card can use it straight away.
+
+displayNextByte() works out the bytes of the command being sent without
+touching any hardware. On the Arduino displaySend() writes them to the
+SPI data register; on the host the recording display in host/mock/
+provides displaySend() and takes them into a model of the screen.*/
+
+#ifndef SPIQUEUE_H
+#define SPIQUEUE_H
+
+#include <stdint.h>
+
+// ST7735 commands used to set up an address window
+#define ST7735_CASET 0x2A
+#define ST7735_RASET 0x2B
+#define ST7735_RAMWR 0x2C
+
+#define DISPLAY_PALETTE_SIZE 16
+#define PALETTE_NONE 0x0F // no pixel (only used for the right pixel of displayRows)
+
+typedef void (*DisplayMarkerHook)(uint8_t id);
+
+void displaySetColour(uint8_t index, uint16_t colour);
+void displaySetMarkerHook(DisplayMarkerHook hook);
+bool displayNextByte(uint8_t* byte, bool* data);
+void displaySend();
+
+#ifdef __AVR__
+void displayBegin();
+#endif
+void displayWindow(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+void displayColour(uint16_t colour, uint16_t count);
+void displayRows(uint8_t left, uint8_t inside, uint8_t right, uint8_t width, uint8_t rows);
+void displayMarker(uint8_t id);
+
+#endif